@@ -32,8 +32,10 @@
 //   Simply edit effectListAudio[] and effectListNoAudio[] below
 //   When audio/non-audio mode has been toggled, you will see three green blinks.
 //
-//   Brightness, selected effect, and auto-cycle are saved in EEPROM after a delay
+//   Brightness, selected effect, auto-cycle, audio mode and palette are saved in EEPROM after a delay
 //   The RGB Shades will automatically start up with the last-selected settings
+//
+//   Built with REMOTE defined, settings and whole frames can also be sent over Serial (see remote.h)
 
 // RGB Shades data output to LEDs is on pin 5
 #define LED_PIN  6
@@ -46,57 +48,149 @@
 #define MAXBRIGHTNESS 72
 #define STARTBRIGHTNESS 102
 
+// Current budget for the LEDs in milliamps, brightness is lowered per frame
+// to stay under it (0 for no limit). Channel currents are FastLED's figures
+// for WS2812 type LEDs at full brightness, plus the idle draw of each LED.
+#define MAXMILLIAMPS 1500
+#define REDMILLIAMPS 16
+#define GREENMILLIAMPS 11
+#define BLUEMILLIAMPS 15
+#define IDLEMILLIAMPS 1
+
 // Cycle time (milliseconds between pattern changes)
+// With a steady beat the change waits for the start of the next bar
 #define cycleTime 15000
 
 // Hue time (milliseconds between hue increments)
 #define hueTime 30
 
+// Confetti fade time (milliseconds per fade step)
+#define confettiFadeTime 3
+
 // Time after changing settings before settings are saved to EEPROM
 #define EEPROMDELAY 2000
 
+// Task table slots for the scheduler, in priority order
+#define TASK_AUDIO 0   // read and analyze the audio input every AUDIODELAY
+#define TASK_BUTTONS 1 // read the buttons every millisecond
+#define TASK_RENDER 2  // draw the next effect frame every effectDelay
+#define TASK_HUE 3     // step the global hue every hueTime
+#define TASK_CYCLE 4   // switch effects every cycleTime (and on a bar) in auto cycle mode
+#define TASK_EEPROM 5  // save changed settings
+#define TASK_SHOW 6    // send changed frames to the LEDs at the end of every pass
+
+// Pixel layout and audio input, can also be set from the compiler command line
+#ifndef XYMAP
+#define XYMAP "XYmap_panel.h" // "XYmap.h" for the 16x5 RGB Shades
+#endif
+#ifndef AUDIOINPUT
+#define AUDIOINPUT "audioMAX9814.h" // "audio.h" for the MSGEQ7 board
+#endif
+
 // Include FastLED library and other useful files
 #include <FastLED.h>
 #include <EEPROM.h>
 #include "messages.h"
 #include "font.h"
-#include "XYmap_panel.h"
+#include XYMAP
+#include "ringmap.h"
 #include "utils.h"
-//#include "audio.h"
-#include "audioMAX9814.h"
+#include "settings.h"
+#include "scheduler.h"
+#include "crossfade.h"
+#include AUDIOINPUT
+#ifndef AUDIOHOLDSSHOW
+#define AUDIOHOLDSSHOW() false // only inputs that sample through the shows need it
+#endif
+#include "beat.h"
+#include "audiorecord.h"
+#include "spectrogram.h"
+#include "text.h"
 #include "effects.h"
 #include "buttons.h"
-
-// list of functions that will be displayed
-functionList effectListAudio[] = {drawVU,
-                                  //                                  RGBpulse,
-                                  drawAnalyzer
-                                 };
-
-functionList effectListNoAudio[] = {heartPulse,
-                                    threeSine,
-                                    drawVU,
-                                    threeDee,
-                                    plasma,
-                                    //RGBpulse,
-                                    confetti,
-                                    rider,
-                                    glitter,
-                                    //drawAnalyzer,
-                                    crawlAnalyzer,
-                                    slantBars,
-                                    colorFill,
-                                    sideRain,
-                                   };
+#include "sram.h"
+#include "profiler.h"
+
+// list of effects that will be displayed
+const effectEntry effectListAudio[] PROGMEM = {EFFECT(drawVU),
+                                               EFFECT(RGBpulse),
+                                               EFFECT(circlePulse),
+                                               EFFECT(diamondPulse),
+                                               EFFECT(waterfall),
+                                               EFFECT(drawAnalyzer)
+                                              };
+
+const effectEntry effectListNoAudio[] PROGMEM = {EFFECT(heartPulse),
+                                                 EFFECT(threeSine),
+                                                 EFFECT(drawVU),
+                                                 EFFECT(threeDee),
+                                                 EFFECT(plasma),
+                                                 //EFFECT(RGBpulse),
+                                                 EFFECT(confetti),
+                                                 EFFECT(rider),
+                                                 EFFECT(glitter),
+                                                 //EFFECT(drawAnalyzer),
+                                                 EFFECT(crawlAnalyzer),
+                                                 EFFECT(slantBars),
+                                                 EFFECT(colorFill),
+                                                 EFFECT(sideRain),
+                                                 EFFECT(scrollTextZero),
+                                                 EFFECT(scrollTextOne),
+                                                 EFFECT(scrollTextTwo),
+                                                };
 
 
 byte numEffects;
 const byte numEffectsAudio = (sizeof(effectListAudio) / sizeof(effectListAudio[0]));
 const byte numEffectsNoAudio = (sizeof(effectListNoAudio) / sizeof(effectListNoAudio[0]));
 
+functionList effectRender; // the running effect
+functionList effectTeardown = NULL;
+
+// Stop the running effect and start another, its state starts out cleared
+// The new effect fades in over the last frame of the old one
+void startEffect(const effectEntry *entry) {
+  effectEntry next;
+  memcpy_P(&next, entry, sizeof(next));
+
+  if (effectTeardown) effectTeardown();
+  startCrossfade();
+  memset(&effectState, 0, sizeof(effectState));
+  effectKeepsFrame = false;
+  effectRender = next.render;
+  effectTeardown = next.teardown;
+  next.init();
+  frameClockStart();
+  frameDirty = true;
+}
+
+// Start an effect from the list in use
+void selectEffect(byte index) {
+  switch (audioEnabled) {
+    case true:
+      startEffect(&effectListAudio[index]);
+      break;
+    case false:
+      startEffect(&effectListNoAudio[index]);
+      break;
+  }
+}
+
+#include "remote.h"
+
+#ifdef BENCHMARK
+#include "benchmark.h"
+#endif
+
 
 // Runs one time at the start of the program (power up or reset)
 void setup() {
+  // mark the free SRAM to see how deep the stack goes (see sram.h)
+  paintStack();
+
+  // load the settings saved in EEPROM, if there are any
+  boolean settingsLoaded = loadSettings();
+
   switch (audioEnabled) {
     case true:
       numEffects = numEffectsAudio;
@@ -106,91 +200,140 @@ void setup() {
       break;
   }
 
-
-  // check to see if EEPROM has been used yet
-  // if so, load the stored settings
-  byte eepromWasWritten = EEPROM.read(0);
-  if (eepromWasWritten == 99) {
-    currentEffect = EEPROM.read(1);
-    autoCycle = EEPROM.read(2);
-    currentBrightness = EEPROM.read(3);
-  }
-
   if (currentEffect > (numEffects - 1)) currentEffect = 0;
+  byte savedPalette = currentPaletteChoice;
+  selectEffect(currentEffect);
+  if (settingsLoaded) selectPalette(savedPalette); // keep the colors from before the power down
 
   // write FastLED configuration data
   FastLED.addLeds<CHIPSET, LED_PIN, COLOR_ORDER>(leds, LAST_VISIBLE_LED + 1);
 
-  // set global brightness value
-  FastLED.setBrightness( scale8(currentBrightness, MAXBRIGHTNESS) );
+  // global brightness is set for each frame, see limitBrightness()
 
   // configure input buttons
   pinMode(MODEBUTTON, INPUT_PULLUP);
   pinMode(BRIGHTNESSBUTTON, INPUT_PULLUP);
-  //  pinMode(STROBEPIN, OUTPUT);
-  //  pinMode(RESETPIN, OUTPUT);
 
   analogReference(DEFAULT);
 
-  //  digitalWrite(RESETPIN, LOW);
-  //  digitalWrite(STROBEPIN, HIGH);
+  // configure the audio input
+  audioSetup();
+
+  startTasks();
+
+  PROFILE_SETUP();
+  CAPTURE_SETUP();
+  REMOTE_SETUP();
+
+#ifdef BENCHMARK
+  runBenchmarks();
+#endif
 
   //  random16_add_entropy(analogRead(ANALOGPIN));
 }
 
-// Runs over and over until power off or reset
-void loop()
-{
-  currentMillis = millis(); // save the current timer value
+// Tasks run from loop(), see scheduler.h
+void audioTask() {
+  PROFILE_START();
+  doAnalogs();
+  if (spectrumUpdated) {
+    spectrumUpdated = false;
+    beatUpdate();             // onsets and tempo
+    CAPTURE_AUDIO();          // send the analysis over Serial, if enabled
+  }
+  PROFILE_END(PHASE_AUDIO);
+}
+
+void buttonsTask() {
+  PROFILE_START();
   updateButtons();          // read, debounce, and process the buttons
   doButtons();              // perform actions based on button state
-  checkEEPROM();            // update the EEPROM if necessary
+  PROFILE_END(PHASE_BUTTONS);
+}
+
+// run the currently selected effect, it sets the time until its next frame
+void renderTask() {
+  PROFILE_START();
+  frameClockTick();
+  effectRender();
+  random16_add_entropy(1); // make the random values a bit more random-ish
+  frameDirty = true;
+  tasks[TASK_RENDER].period = effectDelay;
+  PROFILE_END(PHASE_EFFECT);
+}
+
+// increment the global hue value
+void hueTask() {
+  hueCycle(1);
+}
 
-  // analyze the audio input
-  if (currentMillis - audioMillis > AUDIODELAY) {
-    audioMillis = currentMillis;
-    doAnalogs();
+// switch to a new effect
+// With a tempo the task first reruns at the start of the next bar, then
+// goes back to cycleTime (buttons.h resets it the same way)
+void cycleTask() {
+  schedTask &task = tasks[TASK_CYCLE];
+  if (autoCycle == true && task.period == cycleTime && beatsPerMinute != 0) {
+    task.period = beatMillisToBar() + 1; // never 0, that would make it an idle task
+    return;
   }
+  task.period = cycleTime;
 
-  // switch to a new effect every cycleTime milliseconds
-  if (currentMillis - cycleMillis > cycleTime && autoCycle == true) {
-    cycleMillis = currentMillis;
+  if (autoCycle == true && !REMOTE_STREAMING()) {
     if (++currentEffect >= numEffects) currentEffect = 0; // loop to start of effect list
-    effectInit = false; // trigger effect initialization when new effect is selected
+    selectEffect(currentEffect);
   }
+}
 
-  // increment the global hue value every hueTime milliseconds
-  if (currentMillis - hueMillis > hueTime) {
-    hueMillis = currentMillis;
-    hueCycle(1); // increment the global hue value
-  }
+void eepromTask() {
+  PROFILE_START();
+  checkEEPROM();            // update the EEPROM if necessary
+  PROFILE_END(PHASE_EEPROM);
+}
 
-  // run the currently selected effect every effectDelay milliseconds
-  if (currentMillis - effectMillis > effectDelay) {
-    effectMillis = currentMillis;
-    switch (audioEnabled) {
-      case true:
-        effectListAudio[currentEffect]();
-        break;
-      case false:
-        effectListNoAudio[currentEffect]();
-        break;
-    }
-    random16_add_entropy(1); // make the random values a bit more random-ish
-  }
+// runs at the end of every pass
+void showTask() {
+  static unsigned long fadeMicros;
 
-  // run a fade effect too if the confetti effect is running
-  switch (audioEnabled) {
-    case true:
-      if (effectListAudio[currentEffect] == confetti) fadeAll(1);
-      break;
-    case false:
-      if (effectListNoAudio[currentEffect] == confetti) fadeAll(1);
-      break;
+  PROFILE_START();
+  // run a fade effect too if the confetti effect is running, one step every confettiFadeTime
+  byte fadeSteps = elapsedSteps(fadeMicros, confettiFadeTime * 1000UL);
+  if (effectRender == confetti && fadeSteps > 0) {
+    for (byte i = 0; i < fadeSteps; i++) fadeAll(1);
+    frameDirty = true;
   }
 
+  // send the contents of the led memory to the LEDs if they changed,
+  // blended with the last effect's frame for a while after a change,
+  // unless the audio input wants the samples of the frame it is filling;
+  // streamed frames only wait for a good one (see remote.h)
+  if (REMOTE_STREAMING() ? REMOTE_HOLDSSHOW() : AUDIOHOLDSSHOW()) {
+    // shown on a later pass
+  } else if (!crossfadeActive) {
+    showIfChanged();
+  } else if (frameDirty) {
+    showCrossfade();
+  }
+  PROFILE_END(PHASE_SHOW);
+}
 
-  FastLED.show(); // send the contents of the led memory to the LEDs
+// Task table in priority order, slots match the TASK_ defines
+schedTask tasks[] = {
+  {audioTask, AUDIODELAY},
+  {buttonsTask, 1},
+  {renderTask, 1},
+  {hueTask, hueTime},
+  {cycleTask, cycleTime},
+  {eepromTask, 100},
+  {showTask, 0},
+};
+const byte numTasks = sizeof(tasks) / sizeof(tasks[0]);
+static_assert(sizeof(tasks) / sizeof(tasks[0]) <= MAXTASKS, "too many tasks");
 
+// Runs over and over until power off or reset
+void loop()
+{
+  PROFILE_LOOP();            // loop timing and profiler commands, if enabled
+  currentMillis = millis(); // save the current timer value
+  REMOTE_LOOP();            // serial commands and frames, if enabled
+  runTasks();               // run the tasks that are due, most important first
 }
-
@@ -0,0 +1,157 @@
+// Compile time XY table generator
+//
+// A layout is described by a mask string, one character per pixel in row
+// order, with '.' marking holes, plus the way the strip is wired:
+//
+//   XYLAYOUT_COLUMNMAJOR  strip runs along columns instead of rows
+//   XYLAYOUT_SERPENTINE   every other row (or column) runs backwards
+//   XYLAYOUT_FLIPFIRST    the first row runs right to left (or the first
+//                         column bottom to top)
+//
+// Visible pixels are numbered along the strip. Holes are numbered after
+// LAST_VISIBLE_LED in row order, so they can still be written and read but
+// are never shown. The XY map defines kMatrixWidth, kMatrixHeight,
+// XYLAYOUT_MASK and XYLAYOUT_FLAGS and then includes this file, which
+// provides:
+//
+//   ledindex_t         uint8_t, or uint16_t for layouts over 255 pixels
+//   LAST_VISIBLE_LED   index of the last pixel on the strip
+//   NUM_LEDS           kMatrixWidth * kMatrixHeight
+//   leds[]             NUM_LEDS pixels, plus a spare one when there are no
+//                      holes so out of bounds coordinates have somewhere to go
+//   XY(x, y)           table lookup in PROGMEM
+//
+// The table is built by the compiler with constexpr functions, limited to
+// single expressions for C++11. Counting recurses by halves so the nesting
+// stays shallow on big layouts.
+
+#define XYLAYOUT_COLUMNMAJOR 1
+#define XYLAYOUT_SERPENTINE 2
+#define XYLAYOUT_FLIPFIRST 4
+
+#define NUM_LEDS (kMatrixWidth * kMatrixHeight)
+
+// Pixel position in the mask, from the position along the strip
+constexpr unsigned int xyStripLength() {
+  return (XYLAYOUT_FLAGS & XYLAYOUT_COLUMNMAJOR) ? kMatrixHeight : kMatrixWidth;
+}
+
+constexpr bool xyStripReversed(unsigned int strip) {
+  return ((XYLAYOUT_FLAGS & XYLAYOUT_SERPENTINE) && (strip & 1)) != bool(XYLAYOUT_FLAGS & XYLAYOUT_FLIPFIRST);
+}
+
+constexpr unsigned int xyStripOffset(unsigned int position) {
+  return xyStripReversed(position / xyStripLength()) ?
+         xyStripLength() - 1 - position % xyStripLength() : position % xyStripLength();
+}
+
+constexpr unsigned int xyCell(unsigned int position) {
+  return (XYLAYOUT_FLAGS & XYLAYOUT_COLUMNMAJOR) ?
+         xyStripOffset(position) * kMatrixWidth + position / xyStripLength() :
+         position / xyStripLength() * kMatrixWidth + xyStripOffset(position);
+}
+
+// Position along the strip, from the pixel position in the mask
+constexpr unsigned int xyPosition(unsigned int x, unsigned int y) {
+  return (XYLAYOUT_FLAGS & XYLAYOUT_COLUMNMAJOR) ?
+         x * xyStripLength() + (xyStripReversed(x) ? kMatrixHeight - 1 - y : y) :
+         y * xyStripLength() + (xyStripReversed(y) ? kMatrixWidth - 1 - x : x);
+}
+
+constexpr bool xyHole(unsigned int cell) {
+  return XYLAYOUT_MASK[cell] == '.';
+}
+
+// Visible pixels on the strip before position last
+constexpr unsigned int xyCountVisible(unsigned int first, unsigned int last) {
+  return last - first == 0 ? 0 :
+         last - first == 1 ? !xyHole(xyCell(first)) :
+         xyCountVisible(first, (first + last) / 2) + xyCountVisible((first + last) / 2, last);
+}
+
+// Holes in the mask before cell last
+constexpr unsigned int xyCountHoles(unsigned int first, unsigned int last) {
+  return last - first == 0 ? 0 :
+         last - first == 1 ? xyHole(first) :
+         xyCountHoles(first, (first + last) / 2) + xyCountHoles((first + last) / 2, last);
+}
+
+constexpr unsigned int xyVisibleLeds() {
+  return xyCountVisible(0, NUM_LEDS);
+}
+
+#define LAST_VISIBLE_LED (xyVisibleLeds() - 1)
+
+constexpr unsigned int xyIndex(unsigned int x, unsigned int y) {
+  return xyHole(y * kMatrixWidth + x) ?
+         xyVisibleLeds() + xyCountHoles(0, y * kMatrixWidth + x) :
+         xyCountVisible(0, xyPosition(x, y));
+}
+
+static_assert(sizeof(XYLAYOUT_MASK) - 1 == NUM_LEDS, "XYLAYOUT_MASK must have kMatrixWidth * kMatrixHeight characters");
+static_assert(xyVisibleLeds() > 0, "XYLAYOUT_MASK has no visible pixels");
+
+// Smallest index type that reaches the spare pixel
+template <bool wide> struct xyIndexType {
+  typedef uint8_t type;
+};
+
+template <> struct xyIndexType<true> {
+  typedef uint16_t type;
+};
+
+typedef xyIndexType<(NUM_LEDS >= 256)>::type ledindex_t;
+
+inline uint8_t xyRead(const uint8_t *entry) {
+  return pgm_read_byte(entry);
+}
+
+inline uint16_t xyRead(const uint16_t *entry) {
+  return pgm_read_word(entry);
+}
+
+// Compile time list of cell numbers 0..n-1, built by halves
+template <unsigned int... cells> struct xyCells {};
+
+template <class first, class second> struct xyJoin;
+
+template <unsigned int... first, unsigned int... second>
+struct xyJoin<xyCells<first...>, xyCells<second...> > {
+  typedef xyCells<first..., (sizeof...(first) + second)...> type;
+};
+
+template <unsigned int n> struct xyMakeCells {
+  typedef typename xyJoin<typename xyMakeCells<n / 2>::type, typename xyMakeCells<n - n / 2>::type>::type type;
+};
+
+template <> struct xyMakeCells<0> {
+  typedef xyCells<> type;
+};
+
+template <> struct xyMakeCells<1> {
+  typedef xyCells<0> type;
+};
+
+struct xyTableType {
+  ledindex_t index[NUM_LEDS];
+};
+
+template <unsigned int... cells>
+constexpr xyTableType xyMakeTable(xyCells<cells...>) {
+  return xyTableType{{ ledindex_t(xyIndex(cells % kMatrixWidth, cells / kMatrixWidth))... }};
+}
+
+const xyTableType xyTable PROGMEM = xyMakeTable(xyMakeCells<NUM_LEDS>::type());
+
+CRGB leds[NUM_LEDS + (xyVisibleLeds() == NUM_LEDS)];
+
+// This function will return the right 'led index number' for
+// a given set of X and Y coordinates on your layout.
+// Any out of bounds address maps to the first hidden pixel.
+ledindex_t XY(byte x, byte y) {
+  if ((x >= kMatrixWidth) || (y >= kMatrixHeight)) {
+    return (LAST_VISIBLE_LED + 1);
+  }
+
+  return xyRead(&xyTable.index[y * kMatrixWidth + x]);
+}
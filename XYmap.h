@@ -29,7 +29,17 @@
 const uint8_t kMatrixWidth = 16;
 const uint8_t kMatrixHeight = 5;
 
-// Pixel layout
+// Pixel layout, one character per pixel, '.' for holes
+// Wired as a plain 16x5 serpentine matrix, every pixel on the strip
+#define XYLAYOUT_MASK \
+  "################" \
+  "################" \
+  "################" \
+  "################" \
+  "################"
+#define XYLAYOUT_FLAGS XYLAYOUT_SERPENTINE
+
+// The Kickstarter shades leave out the nose and the outer corners:
 //
 //      0  1  2  3  4  5  6  7  8  9 10 11 12 13 14 15
 //   +------------------------------------------------
@@ -38,41 +48,14 @@ const uint8_t kMatrixHeight = 5;
 // 2 | 30 31 32 33 34 35 36  .  . 37 38 39 40 41 42 43
 // 3 | 57 56 55 54 53 52 51  .  . 50 49 48 47 46 45 44
 // 4 |  . 58 59 60 61 62  .  .  .  . 63 64 65 66 67  .
+//
+// #define XYLAYOUT_MASK \
+//   ".##############." \
+//   "################" \
+//   "#######..#######" \
+//   "#######..#######" \
+//   ".#####....#####."
 
-#define NUM_LEDS (kMatrixWidth * kMatrixHeight)
-CRGB leds[ NUM_LEDS ];
-
-
-// This function will return the right 'led index number' for 
-// a given set of X and Y coordinates on your RGB Shades. 
-// This code, plus the supporting 80-byte table is much smaller 
-// and much faster than trying to calculate the pixel ID with code.
-#define LAST_VISIBLE_LED 79
-uint8_t XY( uint8_t x, uint8_t y)
-{
-  // any out of bounds address maps to the first hidden pixel
-  if( (x >= kMatrixWidth) || (y >= kMatrixHeight) ) {
-    return (LAST_VISIBLE_LED + 1);
-  }
-
-//  const uint8_t ShadesTable[] = {
-//     68,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 69,
-//     29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17, 16, 15, 14,
-//     30, 31, 32, 33, 34, 35, 36, 70, 71, 37, 38, 39, 40, 41, 42, 43,
-//     57, 56, 55, 54, 53, 52, 51, 72, 73, 50, 49, 48, 47, 46, 45, 44,
-//     74, 58, 59, 60, 61, 62, 75, 76, 77, 78, 63, 64, 65, 66, 67, 79
-//  };
-  const uint8_t ShadesTable[] = {
-      0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15,
-     31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17, 16,
-     32, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, 44, 45, 46, 47,
-     63, 62, 61, 60, 59, 58, 57, 56, 55, 54, 53, 52, 51, 50, 49, 48,
-     64, 65, 66, 67, 68, 69, 70, 71, 72, 73, 74, 75, 76, 77, 78, 79
-  };
-
-  uint8_t i = (y * kMatrixWidth) + x;
-  uint8_t j = ShadesTable[i];
-  return j;
-}
-
+#include "XYlayout.h"
 
+static_assert(xyIndex(0, 0) == 0 && xyIndex(0, 1) == 31 && xyIndex(15, 1) == 16 && xyIndex(15, 4) == 79, "shades layout");
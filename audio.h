@@ -1,4 +1,20 @@
 // Interface with MSGEQ7 chip for audio analysis
+//
+// The smoothing, peak decay and AGC math can run in float (the original
+// code) or in fixed point. Fixed point keeps the smoothed levels in Q16.16
+// and the gain in Q4.12, replacing the soft-float calls with 16x16 bit
+// multiplies. Fed the same band reads, the fixed point levels stay within
+// 2 counts of the float ones; make audio-equivalence in host/ checks that
+// and fails if they do not, with int 16 bits wide as on the AVR.
+// The cycle counts of the two versions on the device have not been
+// measured yet: make simavr-bench with SIMAVRFLAGS='-DAUDIOINPUT=\"audio.h\"',
+// and again with -DFLOATAUDIO added, gives the doAnalogs() row in cycles.
+// The host timing audioeq prints uses a hardware FPU, so it says nothing
+// about soft-float on the AVR.
+// Define FLOATAUDIO, here or on the compiler command line, to go back to float.
+#ifndef FLOATAUDIO
+#define FIXEDPOINTAUDIO
+#endif
 
 #define AUDIODELAY 10
 
@@ -10,7 +26,6 @@
 // Smooth/average settings
 #define SPECTRUMSMOOTH 0.08
 #define PEAKDECAY 0.01
-#define NOISEFLOOR 65
 
 // AGC settings
 #define AGCSMOOTH 0.004
@@ -19,14 +34,48 @@
 
 #define NOISEFLOOR 200 // NOISEFLOOR allows to cut noise in the low power values
 
+// Fixed point versions of the settings above
+#define Q16(x) ((unsigned long)((x) * 65536.0 + 0.5))
+#define Q12(x) ((unsigned int)((x) * 4096.0 + 0.5))
+
+// AGCSMOOTH is 262.144 in Q16, and the AGC settles over thousands of
+// updates, long enough for the 0.05% lost by rounding to show in the gain.
+// Its decay is done as 262 in Q16 plus the rest in Q32.
+#define AGCSMOOTHQ16 ((unsigned int)(AGCSMOOTH * 65536.0))
+#define AGCSMOOTHREST ((unsigned int)((AGCSMOOTH * 65536.0 - AGCSMOOTHQ16) * 65536.0 + 0.5))
+
 // Global variables
 unsigned int spectrumValue[7];  // holds raw adc values
-float prev_value[7] = {0};      // holds previous values, useful if we want to apply a low pass filter.
+boolean spectrumUpdated = false; // set by doAnalogs(), cleared by the reader
+unsigned int prev_value[7] = {0}; // holds previous values, useful if we want to apply a low pass filter.
                                 // spectrumValue[i]  = prev_value[i] + (input - prev_value[i]) * lowPass_audio;
+#ifdef FIXEDPOINTAUDIO
+unsigned int spectrumDecay[7] = {0}; // holds time-averaged values (integer part of spectrumDecayQ)
+unsigned int spectrumPeaks[7] = {0}; // holds peak values (integer part of spectrumPeaksQ)
+unsigned long spectrumDecayQ[7] = {0}; // Q16.16
+unsigned long spectrumPeaksQ[7] = {0}; // Q16.16
+unsigned long audioAvgQ = Q16(270.0);  // Q16.16
+unsigned int gainAGC = 0;              // Q4.12
+#else
 float spectrumDecay[7] = {0};   // holds time-averaged values
 float spectrumPeaks[7] = {0};   // holds peak values
 float audioAvg = 270.0;
 float gainAGC = 0.0;
+#endif
+
+// Multiply a Q16.16 value by a Q16 fraction using 16x16 bit products
+unsigned long scaleQ16(unsigned long value, unsigned int fraction) {
+  return (unsigned long)(uint16_t)(value >> 16) * fraction + (((unsigned long)(uint16_t)value * fraction) >> 16);
+}
+
+// Configure the MSGEQ7 control pins
+void audioSetup() {
+  pinMode(STROBEPIN, OUTPUT);
+  pinMode(RESETPIN, OUTPUT);
+
+  digitalWrite(RESETPIN, LOW);
+  digitalWrite(STROBEPIN, HIGH);
+}
 
 void doAnalogs() {
 
@@ -71,6 +120,19 @@ void doAnalogs() {
     // prepare average for AGC
     analogsum += spectrumValue[i];
 
+#ifdef FIXEDPOINTAUDIO
+    // apply current gain value
+    spectrumValue[i] = ((unsigned long)spectrumValue[i] * gainAGC) >> 12;
+
+    // process time-averaged values
+    spectrumDecayQ[i] += (unsigned long)spectrumValue[i] * Q16(SPECTRUMSMOOTH) - scaleQ16(spectrumDecayQ[i], Q16(SPECTRUMSMOOTH));
+    spectrumDecay[i] = (spectrumDecayQ[i] + 0x8000) >> 16;
+
+    // process peak values
+    if (spectrumPeaksQ[i] < spectrumDecayQ[i]) spectrumPeaksQ[i] = spectrumDecayQ[i];
+    spectrumPeaksQ[i] -= scaleQ16(spectrumPeaksQ[i], Q16(PEAKDECAY));
+    spectrumPeaks[i] = (spectrumPeaksQ[i] + 0x8000) >> 16;
+#else
     // apply current gain value
     spectrumValue[i] *= gainAGC;
 
@@ -80,8 +142,21 @@ void doAnalogs() {
     // process peak values
     if (spectrumPeaks[i] < spectrumDecay[i]) spectrumPeaks[i] = spectrumDecay[i];
     spectrumPeaks[i] = spectrumPeaks[i] * (1.0 - PEAKDECAY);
+#endif
   }
 
+#ifdef FIXEDPOINTAUDIO
+  // Calculate audio levels for automatic gain, AGCSMOOTH / 7 is folded into one Q24 constant
+  audioAvgQ += (((unsigned long)analogsum * (unsigned long)(AGCSMOOTH / 7.0 * 16777216.0 + 0.5)) >> 8)
+               - scaleQ16(audioAvgQ, AGCSMOOTHQ16) - (((audioAvgQ >> 16) * AGCSMOOTHREST) >> 16);
+
+  // Calculate gain adjustment factor, 270 / audioAvg in Q4.12
+  unsigned long audioAvgQ8 = audioAvgQ >> 8;
+  unsigned long gain = (audioAvgQ8 > 0) ? (270UL << 20) / audioAvgQ8 : Q12(GAINUPPERLIMIT);
+  if (gain > Q12(GAINUPPERLIMIT)) gain = Q12(GAINUPPERLIMIT);
+  if (gain < Q12(GAINLOWERLIMIT)) gain = Q12(GAINLOWERLIMIT);
+  gainAGC = gain;
+#else
   // Calculate audio levels for automatic gain
   audioAvg = (1.0 - AGCSMOOTH) * audioAvg + AGCSMOOTH * (analogsum / 7.0);
 
@@ -89,33 +164,7 @@ void doAnalogs() {
   gainAGC = 270.0 / audioAvg;
   if (gainAGC > GAINUPPERLIMIT) gainAGC = GAINUPPERLIMIT;
   if (gainAGC < GAINLOWERLIMIT) gainAGC = GAINLOWERLIMIT;
+#endif
 
+  spectrumUpdated = true;
 }
-
-// Attempt at beat detection
-byte beatTriggered = 0;
-#define beatLevel 20.0
-#define beatDeadzone 30.0
-#define beatDelay 50
-float lastBeatVal = 0;
-byte beatDetect() {
-  static float beatAvg = 0;
-  static unsigned long lastBeatMillis;
-  float specCombo = (spectrumDecay[0] + spectrumDecay[1]) / 2.0;
-  beatAvg = (1.0 - AGCSMOOTH) * beatAvg + AGCSMOOTH * specCombo;
-
-  if (lastBeatVal < beatAvg) lastBeatVal = beatAvg;
-  if ((specCombo - beatAvg) > beatLevel && beatTriggered == 0 && currentMillis - lastBeatMillis > beatDelay) {
-    beatTriggered = 1;
-    lastBeatVal = specCombo;
-    lastBeatMillis = currentMillis;
-    return 1;
-  } else if ((lastBeatVal - specCombo) > beatDeadzone) {
-    beatTriggered = 0;
-    return 0;
-  } else {
-    return 0;
-  }
-
-}
-
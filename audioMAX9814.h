@@ -1,73 +1,295 @@
+// Interface with MAX9814 microphone amplifier for audio analysis
+//
+// The ADC runs free (about 9600 samples/s) and its interrupt pushes every
+// conversion into a small ring buffer. doAnalogs() only drains what has
+// arrived since the last call, so it never blocks the main loop.
+//
+// The 32 sample buffer covers 3.3 ms of the main loop not draining it,
+// enough for the effects but not for the two long stalls: FastLED.show()
+// keeps interrupts off for about 30 us per LED (6.5 ms on the panel) and
+// an EEPROM save waits 3.3 ms per byte written (about 30 ms). Covering
+// those would take most of the free SRAM, so the samples are allowed to
+// have gaps instead. doAnalogs() notices both, a show from showCount and
+// a full buffer from sampleOverruns, and drops the partly filled FFT
+// frame and the samples around the gap, so no frame ever spans one.
+// Dropping a frame at every show would starve the analysis with effects
+// that show more often than a frame fills, so showTask() holds changed
+// frames back until the FFT frame is done (AUDIOHOLDSSHOW) and the show
+// lands between two of them. fftDropped counts the partly filled frames
+// lost anyway.
+//
+// Every 64 samples (6.7 ms) the frame goes through a 16 bit fixed point
+// radix-2 FFT and the bins are summed into seven bands, so the analyzer
+// effects get a real spectrum instead of one level copied seven times.
+// The FFT buffers cost 256 bytes of SRAM; the twiddle, window and band
+// tables live in flash.
+//
+// Cycle budget per frame on a 16MHz ATmega328 (192 butterflies with four
+// 16x16 multiplies each, plus window and band sums): about 40,000 cycles,
+// 2.5 ms, or 37% of the 6.7 ms frame. This is an estimate, not measured
+// yet: the processFrame row of make simavr-bench counts the real cycles,
+// and on the device the last call's time is kept in fftMicros, which the
+// profiler prints (see profiler.h).
+
 #define AUDIODELAY 1
 #define SPECTRUMSMOOTH 0.08
 #define PEAKDECAY 0.01
 #define NOISEFLOOR 65
 
+// Pin definitions
+#define ANALOGPIN 0
+
 // AGC settings
 #define AGCSMOOTH 0.004
 #define GAINUPPERLIMIT 15.0
 #define GAINLOWERLIMIT 0.1
 
+// Sample settings
+#define SAMPLEBUFFERSIZE 32 // ring buffer length, must be a power of two
+#define SAMPLEMICROS 104    // time per free running conversion, 13 ADC clocks at 125kHz
+
+// FFT settings
+#define FFTSIZE 64 // samples per frame, 150Hz per bin at 9600 samples/s
+#define FFTLOG2 6
+
 // Global variables
 unsigned int spectrumValue[7];  // holds raw adc values
+boolean spectrumUpdated = false; // set by processFrame(), cleared by the reader
 float spectrumDecay[7] = {0};   // holds time-averaged values
 float spectrumPeaks[7] = {0};   // holds peak values
 float audioAvg = 270.0;
 float gainAGC = 0.0;
 
-int maximum = 600;
-uint16_t sampleWindow = 10;
-unsigned int sample;
+volatile unsigned int sampleBuffer[SAMPLEBUFFERSIZE]; // written by the ADC interrupt
+volatile byte sampleHead = 0;    // next slot the interrupt will fill
+volatile byte sampleOverruns = 0; // samples dropped because the buffer was full
+volatile byte sampleTail = 0;    // next slot doAnalogs() will read, compared by the interrupt
+byte overrunsSeen = 0;           // sampleOverruns at the last gap doAnalogs() handled
+byte showsSeen = 0;              // showCount at the last gap doAnalogs() handled
 
-void doAnalogs() {
-  unsigned long startMillis = millis(); // Start of sample window
-  unsigned int peakToPeak = 0;   // peak-to-peak level
+int fftReal[FFTSIZE]; // raw samples while filling, then real part of the spectrum
+int fftImag[FFTSIZE];
+byte fftFill = 0;
+boolean fftFilling = false;       // a frame is filling, or waiting for its first sample after a gap
+unsigned long fftStartMicros = 0; // when it started
+boolean fftFrameDone = false;     // the last doAnalogs() call finished a frame
+unsigned int fftMicros = 0; // time spent on the last processFrame() call
+unsigned int fftDropped = 0; // partly filled frames dropped at a gap in the samples
 
-  unsigned int signalMax = 0;
-  unsigned int signalMin = 600;
+// True while a show would cut a frame short: not right after a frame was
+// finished, which only costs the few samples of the next one, and not
+// once a frame has had a whole frame time plus the buffer's worth of late
+// draining, so a stalled input cannot stop the shows
+#define AUDIOHOLDSSHOW() (fftFilling && !fftFrameDone && micros() - fftStartMicros < (FFTSIZE + SAMPLEBUFFERSIZE) * SAMPLEMICROS)
 
-  // store sum of values for AGC
-  int analogsum = 0;
+// sin(2 * PI * i / FFTSIZE) in Q15, three quarter waves so cos is an offset read
+const int16_t fftSine[FFTSIZE * 3 / 4] PROGMEM = {
+  0, 3212, 6393, 9512, 12539, 15446, 18204, 20787,
+  23170, 25329, 27245, 28898, 30273, 31356, 32137, 32609,
+  32767, 32609, 32137, 31356, 30273, 28898, 27245, 25329,
+  23170, 20787, 18204, 15446, 12539, 9512, 6393, 3212,
+  0, -3212, -6393, -9512, -12539, -15446, -18204, -20787,
+  -23170, -25329, -27245, -28898, -30273, -31356, -32137, -32609
+};
 
-  // collect data for 50 mS
-  while (millis() - startMillis < sampleWindow)
-  {
-    sample = analogRead(0);
+// First half of a Hann window, 0-255
+const byte fftWindow[FFTSIZE / 2] PROGMEM = {
+  0, 1, 3, 6, 10, 16, 22, 30, 38, 48, 58, 69, 81, 93, 105, 118,
+  131, 143, 156, 168, 180, 191, 202, 212, 221, 229, 236, 242, 247, 251, 254, 255
+};
 
-    if (sample < 1024)  // toss out spurious readings
-    {
-      if (sample > signalMax)
-      {
-        signalMax = sample;  // save just the max levels
-      }
-      else if (sample < signalMin)
-      {
-        signalMin = sample;  // save just the min levels
+// First FFT bin of each band, roughly the MSGEQ7 octave spacing squeezed
+// below the 4.8kHz Nyquist limit: 150, 300, 450, 750, 1200, 2100, 3300Hz
+const byte bandBins[8] PROGMEM = {1, 2, 3, 5, 8, 14, 22, FFTSIZE / 2};
+
+#ifdef __AVR__
+// ADC conversion complete, queue the sample for doAnalogs()
+ISR(ADC_vect) {
+  byte nextHead = (sampleHead + 1) & (SAMPLEBUFFERSIZE - 1);
+  if (nextHead != sampleTail) {
+    sampleBuffer[sampleHead] = ADC;
+    sampleHead = nextHead;
+  } else {
+    sampleOverruns++;
+  }
+}
+
+// Start the ADC in free running mode on ANALOGPIN
+void audioSetup() {
+  ADMUX = _BV(REFS0) | (ANALOGPIN & 0x07); // AVcc reference, right adjusted
+  ADCSRB = 0; // free running trigger source
+  DIDR0 = _BV(ANALOGPIN); // disable the digital input buffer on the audio pin
+  // enable, start, auto trigger, interrupt, 16MHz/128 = 125kHz ADC clock
+  ADCSRA = _BV(ADEN) | _BV(ADSC) | _BV(ADATE) | _BV(ADIE) | _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0);
+}
+#else
+// No ADC interrupt off the device, so queue analogRead() samples at the
+// rate the free running converter would have produced them
+unsigned long sampleMicros = 0;
+
+void audioSetup() {
+  sampleMicros = micros();
+}
+
+void pollSamples() {
+  while (micros() - sampleMicros >= SAMPLEMICROS) {
+    sampleMicros += SAMPLEMICROS;
+    unsigned int sample = analogRead(ANALOGPIN); // the converter runs even when the buffer is full
+    byte nextHead = (sampleHead + 1) & (SAMPLEBUFFERSIZE - 1);
+    if (nextHead != sampleTail) {
+      sampleBuffer[sampleHead] = sample;
+      sampleHead = nextHead;
+    } else {
+      sampleOverruns++;
+    }
+  }
+}
+#endif
+
+// In place radix-2 decimation in time FFT, fftImag must be zero on entry.
+// Every stage halves its outputs so 16 bit values cannot overflow.
+void fixFFT() {
+
+  // reorder the input into bit reversed order
+  byte j = 0;
+  for (byte i = 1; i < FFTSIZE; i++) {
+    byte bit = FFTSIZE >> 1;
+    while (j & bit) {
+      j ^= bit;
+      bit >>= 1;
+    }
+    j ^= bit;
+    if (i < j) {
+      int temp = fftReal[i];
+      fftReal[i] = fftReal[j];
+      fftReal[j] = temp;
+    }
+  }
+
+  // butterflies, one pass per stage
+  byte twiddleStep = FFTSIZE / 2;
+  for (byte span = 1; span < FFTSIZE; span <<= 1) {
+    for (byte k = 0; k < span; k++) {
+      int wr = (int16_t)pgm_read_word(fftSine + k * twiddleStep + FFTSIZE / 4); // cos
+      int wi = -(int16_t)pgm_read_word(fftSine + k * twiddleStep);         // -sin
+      for (byte a = k; a < FFTSIZE; a += span * 2) {
+        byte b = a + span;
+        int tr = ((long)wr * fftReal[b] - (long)wi * fftImag[b]) >> 16;
+        int ti = ((long)wr * fftImag[b] + (long)wi * fftReal[b]) >> 16;
+        int qr = fftReal[a] >> 1;
+        int qi = fftImag[a] >> 1;
+        fftReal[b] = qr - tr;
+        fftImag[b] = qi - ti;
+        fftReal[a] = qr + tr;
+        fftImag[a] = qi + ti;
       }
     }
+    twiddleStep >>= 1;
+  }
+}
+
+// Turn one full frame of samples into the seven band levels
+void processFrame() {
+  unsigned long startMicros = micros();
+
+  // remove the microphone bias and apply the window
+  long sampleSum = 0;
+  for (byte i = 0; i < FFTSIZE; i++) sampleSum += fftReal[i];
+  int sampleMean = sampleSum >> FFTLOG2;
+  for (byte i = 0; i < FFTSIZE; i++) {
+    byte w = pgm_read_byte(fftWindow + (i < FFTSIZE / 2 ? i : FFTSIZE - 1 - i));
+    fftReal[i] = ((long)(fftReal[i] - sampleMean) * w) >> 4;
+    fftImag[i] = 0;
   }
 
-  peakToPeak = signalMax - signalMin;  // max - min = peak-peak amplitude
-  if (peakToPeak < 0) peakToPeak = 0;
-  else if (peakToPeak > 1023) peakToPeak = 0;
-  
-  // prepare average for AGC
-  analogsum += peakToPeak;
+  fixFFT();
 
-  // apply current gain value
-  peakToPeak *= gainAGC;
+  // store sum of values for AGC
+  int analogsum = 0;
+
+  byte bin = pgm_read_byte(bandBins);
+  for (byte i = 0; i < 7; i++) {
+
+    // sum the bin magnitudes of this band, |z| ~ max + 3/8 min
+    unsigned int bandSum = 0;
+    byte lastBin = pgm_read_byte(bandBins + i + 1);
+    for (; bin < lastBin; bin++) {
+      unsigned int re = abs(fftReal[bin]);
+      unsigned int im = abs(fftImag[bin]);
+      bandSum += (re > im) ? re + (im * 3 >> 3) : im + (re * 3 >> 3);
+    }
+
+    // scaled so a tone lands near its old peak-to-peak level
+    spectrumValue[i] = bandSum >> 2;
+
+    // prepare average for AGC
+    analogsum += spectrumValue[i];
+
+    // apply current gain value
+    spectrumValue[i] *= gainAGC;
 
-  for (int i = 0; i < 7; i++) {
-    spectrumValue[i] = peakToPeak;
     // process time-averaged values
     spectrumDecay[i] = (1.0 - SPECTRUMSMOOTH) * spectrumDecay[i] + SPECTRUMSMOOTH * spectrumValue[i];
+
+    // process peak values
+    if (spectrumPeaks[i] < spectrumDecay[i]) spectrumPeaks[i] = spectrumDecay[i];
+    spectrumPeaks[i] = spectrumPeaks[i] * (1.0 - PEAKDECAY);
   }
+
   // Calculate audio levels for automatic gain
-  audioAvg = (1.0 - AGCSMOOTH) * audioAvg + AGCSMOOTH * (analogsum);
+  audioAvg = (1.0 - AGCSMOOTH) * audioAvg + AGCSMOOTH * (analogsum / 7.0);
 
   // Calculate gain adjustment factor
   gainAGC = 270.0 / audioAvg;
   if (gainAGC > GAINUPPERLIMIT) gainAGC = GAINUPPERLIMIT;
   if (gainAGC < GAINLOWERLIMIT) gainAGC = GAINLOWERLIMIT;
 
+  spectrumUpdated = true;
+  fftFill = 0;
+  fftFilling = false;
+  fftFrameDone = true;
+  fftMicros = micros() - startMicros;
+}
+
+// Drain the sample buffer, at most SAMPLEBUFFERSIZE samples per call
+void doAnalogs() {
+#ifndef __AVR__
+  pollSamples();
+#endif
+  byte head = sampleHead; // single byte, read atomically
+  fftFrameDone = false;
+
+  // the buffered samples straddle a show, nothing was sampled during it
+  boolean gap = showCount != showsSeen;
+  if (gap) {
+    showsSeen = showCount;
+    sampleTail = head;
+  }
+
+  // an overrun only happens with the buffer full, so everything up to
+  // head was sampled before it and the gap comes after them
+  byte overruns = sampleOverruns;
+  if (overruns != overrunsSeen) {
+    overrunsSeen = overruns;
+    gap = true;
+  }
+
+  while (sampleTail != head) {
+    if (!fftFilling) {
+      fftFilling = true;
+      fftStartMicros = micros();
+    }
+    fftReal[fftFill] = sampleBuffer[sampleTail];
+    sampleTail = (sampleTail + 1) & (SAMPLEBUFFERSIZE - 1);
+
+    if (++fftFill >= FFTSIZE) processFrame();
+  }
+
+  // start over after the gap
+  if (gap) {
+    if (fftFill > 0) fftDropped++;
+    fftFill = 0;
+    fftFilling = true;
+    fftStartMicros = micros();
+  }
 }
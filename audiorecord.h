@@ -0,0 +1,119 @@
+// Binary recording of the audio analysis, one record per spectrum
+//
+// Built with AUDIOCAPTURE defined, audioTask() sends a record over Serial
+// after every new spectrum, so the analysis of a real gig can be captured
+// from the device. host/audioReplay.h plays a capture back into the same
+// arrays in the host build, where every audio effect can then be profiled
+// or checked against a known frame hash, faster than real time.
+// AUDIOCAPTURE and PROFILE both use Serial, build with one of them.
+//
+// Record, AUDIORECORDSIZE bytes, words little endian:
+//
+//   0   2  sync, 0xA5 0x5A
+//   2   1  AUDIORECORDVERSION
+//   3   4  micros() when the spectrum was ready
+//   7  14  spectrumValue[7]
+//  21  14  spectrumDecay[7], rounded
+//  35  14  spectrumPeaks[7], rounded
+//  49   2  gainAGC in Q4.12
+//  51   1  AUDIORECORD_ONSET, AUDIORECORD_TEMPO flags from beat.h
+//  52   1  beatsPerMinute
+//  53   1  crc8() of bytes 2-52
+//
+// The MAX9814 input makes 150 spectra a second, 8100 bytes/s, 70% of the
+// line at 115200 baud. A reader that loses sync looks for the next sync
+// pair that starts a record with a good crc.
+
+#define AUDIORECORDSIZE 54
+#define AUDIORECORDVERSION 1
+#define AUDIORECORDSYNC0 0xA5
+#define AUDIORECORDSYNC1 0x5A
+#define AUDIORECORD_ONSET 1 // beatOnset was set by this spectrum
+#define AUDIORECORD_TEMPO 2 // beatsPerMinute was not 0
+#define AUDIOCAPTUREBAUD 115200
+
+void putRecordWord(byte *&out, uint16_t value) {
+  *out++ = value;
+  *out++ = value >> 8;
+}
+
+uint16_t getRecordWord(const byte *&in) {
+  uint16_t value = in[0] | (in[1] << 8);
+  in += 2;
+  return value;
+}
+
+// Levels are float on some inputs and fixed point on others
+uint16_t recordLevel(float level) {
+  if (level <= 0) return 0;
+  if (level >= 65535) return 65535;
+  return level + 0.5;
+}
+
+uint16_t recordLevel(unsigned int level) {
+  return level;
+}
+
+uint16_t recordGain(float gain) {
+  return recordLevel(gain * 4096);
+}
+
+uint16_t recordGain(unsigned int gain) {
+  return gain; // already Q4.12
+}
+
+void packAudioRecord(byte *record, unsigned long recordMicros) {
+  byte *out = record;
+  *out++ = AUDIORECORDSYNC0;
+  *out++ = AUDIORECORDSYNC1;
+  *out++ = AUDIORECORDVERSION;
+  putRecordWord(out, recordMicros);
+  putRecordWord(out, recordMicros >> 16);
+  for (byte i = 0; i < 7; i++) putRecordWord(out, spectrumValue[i]);
+  for (byte i = 0; i < 7; i++) putRecordWord(out, recordLevel(spectrumDecay[i]));
+  for (byte i = 0; i < 7; i++) putRecordWord(out, recordLevel(spectrumPeaks[i]));
+  putRecordWord(out, recordGain(gainAGC));
+  *out++ = (beatOnset ? AUDIORECORD_ONSET : 0) | (beatsPerMinute != 0 ? AUDIORECORD_TEMPO : 0);
+  *out++ = beatsPerMinute;
+  *out = crc8(record + 2, AUDIORECORDSIZE - 3);
+}
+
+boolean audioRecordValid(const byte *record) {
+  return record[0] == AUDIORECORDSYNC0 && record[1] == AUDIORECORDSYNC1 &&
+         record[2] == AUDIORECORDVERSION &&
+         record[AUDIORECORDSIZE - 1] == crc8(record + 2, AUDIORECORDSIZE - 3);
+}
+
+unsigned long audioRecordMicros(const byte *record) {
+  const byte *in = record + 3;
+  unsigned long low = getRecordWord(in);
+  return low | ((unsigned long)getRecordWord(in) << 16);
+}
+
+#ifdef AUDIOCAPTURE
+// Send the spectrum that was just analyzed
+void captureAudio() {
+  byte record[AUDIORECORDSIZE];
+  packAudioRecord(record, micros());
+  Serial.write(record, AUDIORECORDSIZE);
+}
+
+#define CAPTURE_SETUP() Serial.begin(AUDIOCAPTUREBAUD)
+#define CAPTURE_AUDIO() captureAudio()
+#else
+#define CAPTURE_SETUP()
+#define CAPTURE_AUDIO()
+#endif
+
+#ifdef AUDIOREPLAY
+// Load a valid record into the arrays of the replay input
+void unpackAudioRecord(const byte *record) {
+  const byte *in = record + 7;
+  for (byte i = 0; i < 7; i++) spectrumValue[i] = getRecordWord(in);
+  for (byte i = 0; i < 7; i++) spectrumDecay[i] = getRecordWord(in);
+  for (byte i = 0; i < 7; i++) spectrumPeaks[i] = getRecordWord(in);
+  gainAGC = getRecordWord(in) / 4096.0;
+  recordedFlags = in[0];
+  recordedBeatsPerMinute = in[1];
+}
+#endif
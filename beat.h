@@ -0,0 +1,237 @@
+// Onset detection and tempo tracking on the seven band spectrum
+//
+// beatUpdate() runs after every new spectrum from the audio input. The
+// spectral flux, the summed rise of all seven bands since the previous
+// spectrum, measures how much new sound just started. A flux well above its
+// running average is an onset, reported once by beatDetect().
+//
+// For the tempo the flux is reduced to one onset strength byte every
+// ONSETMILLIS. Each new strength is multiplied with the ones BEATMINLAG to
+// BEATMAXLAG slots back and added to a leaky sum per lag, a running
+// autocorrelation over the last few seconds. The lag with the biggest sum
+// is the beat period (60-176 BPM), refined between slots with a parabola
+// through its neighbours. Every second or third beat lines up as well, so
+// the shortest lag with a peak nearly as strong is taken instead. Off beats
+// as strong as the beats double the tempo, as they would for a listener
+// tapping along to the hats.
+//
+// Once a tempo stands out, beatPhase runs from 0 to 255 over each beat and
+// beatCount counts beats. The phase starts where the onsets in the history,
+// folded at the beat period, line up best, and is pulled a little towards
+// that position every slot. There is no downbeat detection: bars are
+// BEATSPERBAR beats counted from the lock.
+// beatsPerMinute is 0 while there is no steady tempo.
+//
+// SRAM: 154 bytes. Cost on a 16MHz ATmega328, estimated and not measured
+// yet: about 600 cycles per spectrum (flux and a 32 bit divide), 0.6% of
+// the 107,000 cycles between two FFT spectra (6.7 ms, the shortest
+// interval of either input), plus about 2500 cycles per ONSETMILLIS slot
+// (34 8x8 multiplies, the lag scan and the phase fold), 0.8% of the
+// 320,000 cycle slot. make simavr-bench counts the real cycles in its
+// beatUpdate and benchBeatSlot rows and fails if either is over 1%.
+
+#define ONSETMILLIS 20     // onset strength slot, 50 per second
+#define ONSETHISTORY 64    // slots kept, a power of two above BEATMAXLAG
+#define ONSETGAPMILLIS 100 // shortest time between two onsets
+#define ONSETTHRESHOLD 24  // strength of an onset, 16 is flux at twice its average
+#define FLUXFLOOR 100      // flux below this is never an onset
+#define BEATMINLAG 17      // 176 BPM
+#define BEATMAXLAG 50      // 60 BPM
+#define BEATLAGS (BEATMAXLAG - BEATMINLAG + 1)
+#define BEATLEAK 8         // lag sums lose 1/256 per slot, about 5 seconds of memory
+#define BEATMINSUM 64      // weakest lag sum that counts as a tempo
+#define BEATSPERBAR 4
+
+// Global variables
+byte beatsPerMinute = 0; // 0 while no tempo is found
+byte beatPhase = 0;      // position in the current beat, 0-255
+byte beatCount = 0;      // beats since the tempo locked, wraps
+unsigned long beatPeriodMicros = 0;
+
+unsigned int lastBands[7];          // spectrumValue of the previous spectrum
+unsigned long fluxAvg16 = 0;        // running average of the flux, times 16
+unsigned long lastOnsetMillis = 0;
+boolean onsetPending = false;       // an onset beatDetect() has not reported yet
+boolean beatOnset = false;          // the last spectrum started an onset
+byte slotStrength = 0;              // strongest onset in the current slot
+unsigned long slotMicros = 0;
+byte onsetHistory[ONSETHISTORY];    // onset strength per slot
+byte onsetHead = 0;                 // slot the next strength goes to
+uint16_t lagSums[BEATLAGS];         // leaky autocorrelation, lag BEATMINLAG first
+uint16_t beatPeriod16 = 0;          // beat period in 1/16 slots, 0 when unlocked
+uint16_t beatPhase16 = 0;
+boolean beatRelock = false;         // the tempo is new, take the phase from the history
+unsigned long phaseMicros = 0;
+
+// Move the beat phase on, counting the beats it passes
+// A correction backwards stops at the start of the beat, so no beat is counted twice
+void advanceBeatPhase(long step) {
+  long phase = (long)beatPhase16 + step;
+  if (phase >= 65536) {
+    phase -= 65536;
+    beatCount++;
+  } else if (phase < 0) {
+    phase = 0;
+  }
+  beatPhase16 = phase;
+  beatPhase = beatPhase16 >> 8;
+}
+
+// A lag sum plus its bigger neighbour, a period between two slots splits over both
+unsigned long lagPair(byte i) {
+  uint16_t before = i > 0 ? lagSums[i - 1] : 0;
+  uint16_t after = i < BEATLAGS - 1 ? lagSums[i + 1] : 0;
+  return (unsigned long)lagSums[i] + (before > after ? before : after);
+}
+
+// Best lag from the autocorrelation, sets beatPeriod16 and beatsPerMinute
+void findTempo() {
+  byte best = 0;
+  unsigned long total = 0;
+  for (byte i = 0; i < BEATLAGS; i++) {
+    total += lagSums[i];
+    if (lagSums[i] > lagSums[best]) best = i;
+  }
+
+  // two or three beats line up as well, take the shortest lag with a peak
+  // nearly as strong as the biggest one
+  unsigned long strongest = lagPair(best);
+  for (byte i = 0; i < best; i++) {
+    if (i == 0 || lagSums[i] < lagSums[i - 1]) continue; // lag 17 may be the side of a shorter one
+    if (lagSums[i] < lagSums[i + 1]) continue;
+    if (lagPair(i) * 3 >= strongest * 2) {
+      best = i;
+      break;
+    }
+  }
+
+  uint16_t peak = lagSums[best];
+  if (peak < BEATMINSUM || peak * (unsigned long)BEATLAGS < total * 2) {
+    beatPeriod16 = 0;
+    beatsPerMinute = 0;
+    return;
+  }
+
+  // parabola through the peak and its neighbours
+  int16_t period16 = (best + BEATMINLAG) * 16;
+  if (best > 0 && best < BEATLAGS - 1) {
+    long before = lagSums[best - 1];
+    long after = lagSums[best + 1];
+    long curve = 2L * peak - before - after;
+    if (curve > 0) period16 += 8 * (after - before) / curve;
+  }
+
+  // follow small changes smoothly, jump to a new tempo
+  int16_t change = period16 - beatPeriod16;
+  if (beatPeriod16 == 0 || abs(change) > beatPeriod16 / 8) {
+    beatPeriod16 = period16;
+    beatRelock = true;
+  } else {
+    beatPeriod16 += change / 8;
+  }
+  beatPeriodMicros = beatPeriod16 * (ONSETMILLIS * 1000UL / 16);
+  beatsPerMinute = 60000000UL / beatPeriodMicros;
+}
+
+// Pull the phase towards the beat position the onset history agrees on
+void alignBeatPhase() {
+  byte lag = (beatPeriod16 + 8) >> 4;
+
+  // slots since the last beat: fold the history at the period
+  byte bestAge = 0;
+  unsigned int bestSum = 0;
+  for (byte age = 0; age < lag; age++) {
+    unsigned int sum = 0;
+    for (byte back = age + 1; back <= ONSETHISTORY; back += lag) {
+      sum += onsetHistory[(onsetHead - back) & (ONSETHISTORY - 1)];
+    }
+    if (sum > bestSum) {
+      bestSum = sum;
+      bestAge = age;
+    }
+  }
+
+  // phase the beat should be at, from the middle of that slot
+  // After a lock the phase only follows within a quarter beat, so an off
+  // beat about as strong as the beat cannot pull it around
+  uint16_t target = ((unsigned long)bestAge * 16 + 8) * 65536UL / beatPeriod16;
+  int16_t error = target - beatPhase16;
+  if (beatRelock) {
+    beatPhase16 = target;
+    beatPhase = beatPhase16 >> 8;
+    beatRelock = false;
+  } else if (abs(error) < 16384) {
+    advanceBeatPhase(error / 8);
+  }
+}
+
+// Add one slot of onset strength to the history and update the tempo
+void beatSlot(byte strength) {
+  for (byte i = 0; i < BEATLAGS; i++) {
+    byte past = onsetHistory[(onsetHead - BEATMINLAG - i) & (ONSETHISTORY - 1)];
+    lagSums[i] -= lagSums[i] >> BEATLEAK;
+    lagSums[i] += ((unsigned int)strength * past) >> 8; // 255 * 255 overflows a 16 bit int
+  }
+  onsetHistory[onsetHead] = strength;
+  onsetHead = (onsetHead + 1) & (ONSETHISTORY - 1);
+
+  findTempo();
+  if (beatPeriod16 != 0) alignBeatPhase();
+}
+
+// Run after every new spectrum
+void beatUpdate() {
+  unsigned long now = micros();
+
+  // spectral flux, only rising bands count
+  unsigned long flux = 0;
+  for (byte i = 0; i < 7; i++) {
+    unsigned int level = spectrumValue[i];
+    if (level > lastBands[i]) flux += level - lastBands[i];
+    lastBands[i] = level;
+  }
+  unsigned long fluxAvg = fluxAvg16 >> 4;
+  fluxAvg16 += flux - fluxAvg;
+
+  // strength is the flux above its average, relative to the average
+  byte strength = 0;
+  if (flux > fluxAvg) {
+    unsigned long excess = (flux - fluxAvg) * 16 / (fluxAvg + 1);
+    strength = excess > 255 ? 255 : excess;
+  }
+  if (strength > slotStrength) slotStrength = strength;
+
+  beatOnset = strength >= ONSETTHRESHOLD && flux >= FLUXFLOOR && currentMillis - lastOnsetMillis >= ONSETGAPMILLIS;
+  if (beatOnset) {
+    onsetPending = true;
+    lastOnsetMillis = currentMillis;
+  }
+
+  // close the slots that ended, empty ones after a stall
+  byte slots = elapsedSteps(slotMicros, ONSETMILLIS * 1000UL);
+  for (byte i = 0; i < slots; i++) {
+    beatSlot(slotStrength);
+    slotStrength = 0;
+  }
+
+  // run the beat clock
+  unsigned long elapsed = now - phaseMicros;
+  phaseMicros = now;
+  if (beatPeriod16 == 0) return;
+  if (elapsed > 65535) elapsed = 65535;
+  advanceBeatPhase((elapsed << 16) / beatPeriodMicros);
+}
+
+// 1 once for every detected onset
+byte beatDetect() {
+  if (!onsetPending) return 0;
+  onsetPending = false;
+  return 1;
+}
+
+// Milliseconds until the next bar starts, only meaningful with a tempo
+unsigned long beatMillisToBar() {
+  byte beatsLeft = BEATSPERBAR - 1 - beatCount % BEATSPERBAR;
+  unsigned long fraction = beatsLeft * 65536UL + (65536UL - beatPhase16); // in 1/65536 beats
+  return ((fraction >> 8) * beatPeriodMicros >> 8) / 1000;
+}
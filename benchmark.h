@@ -0,0 +1,197 @@
+// Per-effect frame cost benchmark
+//
+// Built only when BENCHMARK is defined. setup() then renders BENCHFRAMES
+// frames of every effect in both effect lists, plus one scrolling text
+// column shift, one audio update, the two halves of the beat tracker,
+// one FFT frame with the MAX9814 input and one crossfade blend, and
+// prints a tab separated table over Serial:
+//
+//   layout  list  index  effect  frames  unit  perframe  stackfree
+//
+// stackfree is what is left of the SRAM between heap and stack at the
+// deepest point of the row (see sram.h), init function included for the
+// effects. It is measured below the bench's own frames, so loop() has a
+// little more; 0 in the host build.
+// On the device (or under simavr, which is cycle accurate) the unit is
+// CPU cycles counted with Timer1; in the host build it is nanoseconds.
+// See host/Makefile for the bench and simavr-bench targets.
+
+#ifndef BENCHFRAMES
+#define BENCHFRAMES 100
+#endif
+
+// One onset slot of a steady 120 BPM pattern, once locked this includes
+// the tempo search and the phase fold
+void benchBeatSlot() {
+  static byte slot = 0;
+  beatSlot(slot == 0 ? 200 : 0);
+  if (++slot >= 25) slot = 0;
+}
+
+// One column of scrolling text, in a state of its own
+void benchShiftText() {
+  static scrollTextState state;
+  if (!state.lines[0].message) startText(state, 0);
+  shiftText(state);
+}
+
+// One crossfade blend halfway through the transition
+void benchCrossfade() {
+  blendCrossfade(128);
+}
+
+struct benchEntry {
+  functionList effect;
+  const char *name;
+};
+
+#define BENCHEFFECT(name) {name, #name}
+
+// Names for the table, any effect missing here is printed as "?"
+const benchEntry benchEffects[] = {
+  BENCHEFFECT(threeSine),
+  BENCHEFFECT(plasma),
+  BENCHEFFECT(rider),
+  BENCHEFFECT(glitter),
+  BENCHEFFECT(colorFill),
+  BENCHEFFECT(threeDee),
+  BENCHEFFECT(sideRain),
+  BENCHEFFECT(confetti),
+  BENCHEFFECT(slantBars),
+  BENCHEFFECT(scrollTextZero),
+  BENCHEFFECT(scrollTextOne),
+  BENCHEFFECT(scrollTextTwo),
+  BENCHEFFECT(benchShiftText),
+  BENCHEFFECT(crawlAnalyzer),
+  BENCHEFFECT(waterfall),
+  BENCHEFFECT(drawAnalyzer),
+  BENCHEFFECT(drawVU),
+  BENCHEFFECT(RGBpulse),
+  BENCHEFFECT(heartPulse),
+  BENCHEFFECT(circlePulse),
+  BENCHEFFECT(diamondPulse),
+  BENCHEFFECT(doAnalogs),
+#ifdef FFTSIZE
+  BENCHEFFECT(processFrame),
+#endif
+  BENCHEFFECT(beatUpdate),
+  BENCHEFFECT(benchBeatSlot),
+  BENCHEFFECT(benchCrossfade),
+};
+
+#ifdef __AVR__
+#include <avr/sleep.h>
+
+#define BENCHUNIT "cycles"
+
+volatile unsigned int benchOverflows = 0;
+
+ISR(TIMER1_OVF_vect) {
+  benchOverflows++;
+}
+
+// Timer1 counts CPU cycles directly, overflows extend it to 32 bits
+void benchStart() {
+  TCCR1A = 0;
+  TCCR1B = _BV(CS10);
+  TIMSK1 = _BV(TOIE1);
+}
+
+unsigned long benchClock() {
+  byte oldSREG = SREG;
+  cli();
+  unsigned int count = TCNT1;
+  unsigned int overflows = benchOverflows;
+  if ((TIFR1 & _BV(TOV1)) && count < 0x8000) overflows++; // overflow not serviced yet
+  SREG = oldSREG;
+  return ((unsigned long)overflows << 16) | count;
+}
+
+// Stop here, simavr exits when the CPU sleeps with interrupts off
+void benchFinish() {
+  Serial.flush();
+  cli();
+  sleep_enable();
+  sleep_cpu();
+}
+#else
+#include <chrono>
+
+#define BENCHUNIT "ns"
+
+void benchStart() {
+}
+
+unsigned long benchClock() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void benchFinish() {
+}
+#endif
+
+const char *benchName(functionList effect) {
+  for (byte i = 0; i < sizeof(benchEffects) / sizeof(benchEffects[0]); i++) {
+    if (benchEffects[i].effect == effect) return benchEffects[i].name;
+  }
+  return "?";
+}
+
+// Time BENCHFRAMES calls of a render function
+void benchRender(const char *list, byte index, functionList effect, boolean paint = true) {
+  if (paint) paintStack();
+  unsigned long total = 0;
+  for (unsigned int frame = 0; frame < BENCHFRAMES; frame++) {
+    delay(1); // let about AUDIODELAY worth of samples arrive
+    if (effect != doAnalogs) doAnalogs(); // keep the audio effects fed, outside the timed region
+    unsigned long start = benchClock();
+    effect();
+    total += benchClock() - start;
+  }
+
+  Serial.print(kMatrixWidth);
+  Serial.print('x');
+  Serial.print(kMatrixHeight);
+  Serial.print('\t');
+  Serial.print(list);
+  Serial.print('\t');
+  Serial.print(index);
+  Serial.print('\t');
+  Serial.print(benchName(effect));
+  Serial.print('\t');
+  Serial.print(BENCHFRAMES);
+  Serial.print('\t');
+  Serial.print(BENCHUNIT);
+  Serial.print('\t');
+  Serial.print(total / BENCHFRAMES);
+  Serial.print('\t');
+  Serial.println(stackUnused());
+}
+
+// Time an effect after its init function and first frame
+void benchEffect(const char *list, byte index, const effectEntry *entry) {
+  paintStack();
+  startEffect(entry);
+  effectRender();
+  benchRender(list, index, effectRender, false);
+}
+
+void runBenchmarks() {
+  Serial.begin(115200);
+  benchStart();
+
+  Serial.println("layout\tlist\tindex\teffect\tframes\tunit\tperframe\tstackfree");
+
+  for (byte i = 0; i < numEffectsAudio; i++) benchEffect("audio", i, &effectListAudio[i]);
+  for (byte i = 0; i < numEffectsNoAudio; i++) benchEffect("noaudio", i, &effectListNoAudio[i]);
+  benchRender("text", 0, benchShiftText);
+  benchRender("audioinput", 0, doAnalogs);
+  benchRender("audioinput", 1, beatUpdate);
+  benchRender("audioinput", 2, benchBeatSlot);
+#ifdef FFTSIZE
+  benchRender("audioinput", 3, processFrame); // one whole frame, doAnalogs() only runs it every 64 samples
+#endif
+  benchRender("transition", 0, benchCrossfade);
+
+  benchFinish();
+}
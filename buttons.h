@@ -96,8 +96,10 @@ void doButtons() {
         break;
     }
     currentEffect = 0;
-    effectInit = false;
     confirmBlink(CRGB::DarkGreen, 3);
+    selectEffect(currentEffect);
+    eepromMillis = currentMillis;
+    eepromOutdated = true;
     buttonStatuses[0] = BTNGUARDTIME;
     buttonStatuses[1] = BTNGUARDTIME;
   } else {
@@ -106,9 +108,10 @@ void doButtons() {
     switch (buttonStatus(0)) {
 
       case BTNRELEASED: // button was pressed and released quickly
-        cycleMillis = currentMillis;
+        tasks[TASK_CYCLE].period = cycleTime; // in case it was waiting for a bar
+        rescheduleTask(TASK_CYCLE);
         if (++currentEffect >= numEffects) currentEffect = 0; // loop to start of effect list
-        effectInit = false; // trigger effect initialization when new effect is selected
+        selectEffect(currentEffect);
         eepromMillis = currentMillis;
         eepromOutdated = true;
         break;
@@ -121,6 +124,7 @@ void doButtons() {
         } else {
           confirmBlink(CRGB::Red, 2);
         }
+        selectEffect(currentEffect); // the blink overwrote leds[], start the effect over
         eepromMillis = currentMillis;
         eepromOutdated = true;
         break;
@@ -132,14 +136,12 @@ void doButtons() {
 
       case BTNRELEASED: // button was pressed and released quickly
         currentBrightness += 51; // increase the brightness (wraps to lowest)
-        FastLED.setBrightness(scale8(currentBrightness, MAXBRIGHTNESS));
         eepromMillis = currentMillis;
         eepromOutdated = true;
         break;
 
       case BTNLONGPRESS: // button was held down for a while
         currentBrightness = STARTBRIGHTNESS; // reset brightness to startup value
-        FastLED.setBrightness(scale8(currentBrightness, MAXBRIGHTNESS));
         eepromMillis = currentMillis;
         eepromOutdated = true;
         break;
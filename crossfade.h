@@ -0,0 +1,98 @@
+// Crossfade from the previous effect when a new one is selected
+//
+// startCrossfade() takes a snapshot of the frame on the LEDs. For the next
+// CROSSFADETIME milliseconds every frame the new effect renders is blended
+// with the snapshot as it is shown, moving from all snapshot to all new
+// effect. The blend never stays in leds[]: effects that draw over their
+// last frame (fades, scrolls, fills) would otherwise keep blending the old
+// image back in.
+//
+// There is no RAM for a second full framebuffer on the 15x15 panel, so the
+// snapshot keeps full color only for layouts of up to CROSSFADEFULLCOLOR
+// visible pixels (240 bytes on the 16x5 shades) and packs each pixel into
+// one RGB332 byte on bigger ones (218 bytes on the panel). The old image
+// is only on screen while it fades out, so the lost color depth is hard
+// to see.
+//
+// The same limit decides how the effect's frame is kept. Up to
+// CROSSFADEFULLCOLOR a copy of it fits on the stack while the blend is
+// shown. Bigger layouts blend in place, which only effects that redraw
+// every pixel of every frame can take. Effects that draw over their last
+// frame set effectKeepsFrame in their init and are not blended there:
+// they start on the old frame, as before the crossfade, and fade or wipe
+// it out themselves.
+
+#define CROSSFADETIME 750      // milliseconds
+#define CROSSFADEFULLCOLOR 100 // largest layout with a full color snapshot
+
+const bool crossfadeFullColor = (LAST_VISIBLE_LED + 1) <= CROSSFADEFULLCOLOR;
+
+byte crossfadeSnapshot[(LAST_VISIBLE_LED + 1) * (crossfadeFullColor ? 3 : 1)];
+boolean crossfadeActive = false;
+unsigned long crossfadeStart;
+boolean effectKeepsFrame = false; // set by the effect's init when it draws over its last frame
+
+// 3 bits red, 3 bits green, 2 bits blue
+byte packRGB332(const CRGB &color) {
+  return (color.r & 0xE0) | ((color.g >> 3) & 0x1C) | (color.b >> 6);
+}
+
+// Spread the bits back over the full range, so white stays white
+CRGB unpackRGB332(byte packed) {
+  byte r = packed & 0xE0;
+  byte g = (packed << 3) & 0xE0;
+  byte b = packed & 0x03;
+  return CRGB(r | (r >> 3) | (r >> 6), g | (g >> 3) | (g >> 6), b * 85);
+}
+
+void startCrossfade() {
+  for (ledindex_t i = 0; i <= LAST_VISIBLE_LED; i++) {
+    if (crossfadeFullColor) {
+      crossfadeSnapshot[i * 3] = leds[i].r;
+      crossfadeSnapshot[i * 3 + 1] = leds[i].g;
+      crossfadeSnapshot[i * 3 + 2] = leds[i].b;
+    } else {
+      crossfadeSnapshot[i] = packRGB332(leds[i]);
+    }
+  }
+  crossfadeActive = true;
+  crossfadeStart = millis();
+}
+
+// Blend the frame in leds[] with the snapshot
+void blendCrossfade(byte amountOfOld) {
+  for (ledindex_t i = 0; i <= LAST_VISIBLE_LED; i++) {
+    CRGB old;
+    if (crossfadeFullColor) {
+      old = CRGB(crossfadeSnapshot[i * 3], crossfadeSnapshot[i * 3 + 1], crossfadeSnapshot[i * 3 + 2]);
+    } else {
+      old = unpackRGB332(crossfadeSnapshot[i]);
+    }
+    nblend(leds[i], old, amountOfOld);
+  }
+}
+
+// Show a newly rendered frame blended with the snapshot, instead of
+// showIfChanged() while crossfadeActive is set. Only called when a frame
+// was rendered (frameDirty), so each one is blended and shown once.
+void showCrossfade() {
+  unsigned long elapsed = millis() - crossfadeStart;
+  if (elapsed >= CROSSFADETIME || (!crossfadeFullColor && effectKeepsFrame)) {
+    crossfadeActive = false; // this frame is all new effect
+    showIfChanged();
+    return;
+  }
+
+  frameDirty = false;
+  byte amountOfOld = 255 - elapsed * 255 / CROSSFADETIME;
+  if (crossfadeFullColor) {
+    CRGB frame[crossfadeFullColor ? LAST_VISIBLE_LED + 1 : 1];
+    memcpy(frame, leds, sizeof(frame));
+    blendCrossfade(amountOfOld);
+    showFrame();
+    memcpy(leds, frame, sizeof(frame));
+  } else {
+    blendCrossfade(amountOfOld); // redrawn in full before the next show
+    showFrame();
+  }
+}
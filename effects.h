@@ -1,21 +1,81 @@
 //   Graphical effects to run on the RGB Shades LED array
-//   Each function should have the following components:
+//   Each effect is an init function and a render function (see effectEntry):
 //    * Must be declared void with no parameters or will break function pointer array
-//    * Check effectInit, if false then init any required settings and set effectInit true
-//    * Set effectDelay (the time in milliseconds until the next run of this effect)
+//    * init runs once when the effect is selected, set effectDelay and any required settings there
+//    * render draws one frame and may change effectDelay (the time in milliseconds until the next frame)
 //    * All animation should be controlled with counters and effectDelay, no delay() or loops
+//    * Counters should advance by frameTicks (see utils.h) rather than by one per call,
+//      so the animation keeps its speed when frames run late
+//    * Keep counters in the effect's member of effectState, not in static variables,
+//      so all effects share the same SRAM; it is cleared before init runs
 //    * Pixel data should be written using leds[XY(x,y)] to map coordinates to the RGB Shades layout
 
+// Init, render and an optional teardown that runs when another effect is selected
+struct effectEntry {
+  functionList init;
+  functionList render;
+  functionList teardown;
+};
+
+// Entry for an effect with init and render functions named name##Init and name
+#define EFFECT(name) {name##Init, name, NULL}
+
+void selectEffect(byte index);
+
+// Per-effect state, only the running effect's member is in use
+struct threeSineState {
+  uint16_t sineOffset; // counter for current position of sine waves, 8.8 fixed point
+};
+
+struct plasmaState {
+  uint16_t offset; // counter for radial color wave motion, 8.8 fixed point
+  unsigned long plasVector; // counter for orbiting plasma center, angle in the top 16 bits
+  distanceTracker columnStart; // distance at the top of the current column
+};
+
+struct riderState {
+  uint16_t riderPos; // 8.8 fixed point
+};
+
+struct colorFillState {
+  byte currentColor;
+  byte currentRow;
+  byte currentDirection;
+};
+
+struct slantBarsState {
+  uint16_t slantPos; // 8.8 fixed point
+};
+
+struct confettiState {
+  uint16_t pixels; // pixels due to be scattered, 8.8 fixed point
+};
+
+struct rgbPulseState {
+  byte RGBcycle;
+  byte lastBeat; // beatCount at the previous frame
+};
+
+union {
+  threeSineState threeSine;
+  plasmaState plasma;
+  riderState rider;
+  colorFillState colorFill;
+  slantBarsState slantBars;
+  confettiState confetti;
+  scrollTextState scrollText; // scrollTextZero, scrollTextOne, scrollTextTwo
+  spectrogram history; // crawlAnalyzer, waterfall
+  rgbPulseState rgbPulse;
+} effectState;
+
 // Triple Sine Waves
-void threeSine() {
+void threeSineInit() {
+  effectDelay = 20;
+}
 
-  static byte sineOffset = 0; // counter for current position of sine waves
+void threeSine() {
 
-  // startup tasks
-  if (effectInit == false) {
-    effectInit = true;
-    effectDelay = 20;
-  }
+  byte sineOffset = effectState.threeSine.sineOffset >> 8;
 
   // Draw one frame of the animation into the LED array
   for (byte x = 0; x < kMatrixWidth; x++) {
@@ -31,52 +91,69 @@ void threeSine() {
     }
   }
 
-  sineOffset++; // byte will wrap from 255 to 0, matching sin8 0-255 cycle
+  effectState.threeSine.sineOffset += frameTicks; // one step per frame, wraps with the sin8 0-255 cycle
 
 }
 
 
 // RGB Plasma
-void plasma() {
+// Distances are measured in tenths of a pixel from the middle of the matrix
+#define PLASMACENTERX ((kMatrixWidth - 1) * 5)
+#define PLASMACENTERY ((kMatrixHeight - 1) * 5)
 
-  static byte offset  = 0; // counter for radial color wave motion
-  static int plasVector = 0; // counter for orbiting plasma center
+void plasmaInit() {
+  effectDelay = 10;
+}
 
-  // startup tasks
-  if (effectInit == false) {
-    effectInit = true;
-    effectDelay = 10;
-  }
+void plasma() {
+
+  plasmaState &state = effectState.plasma;
+  byte offset = state.offset >> 8;
+  distanceTracker &columnStart = state.columnStart;
 
   // Calculate current center of plasma pattern (can be offscreen)
-  int xOffset = cos8(plasVector / 256);
-  int yOffset = sin8(plasVector / 256);
+  int xOffset = cos8(state.plasVector >> 16);
+  int yOffset = sin8(state.plasVector >> 16);
+
+  // Offsets from the center to pixel 0,0; each pixel step adds 10
+  int dx = xOffset - 127 - PLASMACENTERX;
+  int dyTop = yOffset - 127 - PLASMACENTERY;
+  unsigned long topSq = sq((long)dx) + sq((long)dyTop);
 
   // Draw one frame of the animation into the LED array
+  // Neighboring pixels differ in distance by 10 at most, so each one starts
+  // from the previous root instead of calculating a square root from scratch.
+  // Squared distances are stepped too: (d + 10)^2 = d^2 + 20 * d + 100
   for (int x = 0; x < kMatrixWidth; x++) {
+    trackDistance(columnStart, topSq);
+    distanceTracker distance = columnStart;
+    unsigned long distSq = topSq;
+    int dy = dyTop;
     for (int y = 0; y < kMatrixHeight; y++) {
-      byte color = sin8(sqrt(sq(((float)x - 7.5) * 10 + xOffset - 127) + sq(((float)y - 2) * 10 + yOffset - 127)) + offset);
+      trackDistance(distance, distSq);
+      byte color = sin8(distance.root + offset);
       leds[XY(x, y)] = CHSV(color, 255, 255);
+      distSq += 20 * (long)dy + 100;
+      dy += 10;
     }
+    topSq += 20 * (long)dx + 100;
+    dx += 10;
   }
 
-  offset++; // wraps at 255 for sin8
-  plasVector += 16; // using an int for slower orbit (wraps at 65536)
+  state.offset += frameTicks; // one step per frame, wraps at 255 for sin8
+  state.plasVector += 16UL * frameTicks; // 1/16 step per frame for slower orbit
 
 }
 
 
 // Scanning pattern left/right, uses global hue cycle
+void riderInit() {
+  effectDelay = 5;
+}
+
 void rider() {
 
-  static byte riderPos = 0;
-
-  // startup tasks
-  if (effectInit == false) {
-    effectInit = true;
-    effectDelay = 5;
-    riderPos = 0;
-  }
+  byte riderPos = effectState.rider.riderPos >> 8;
 
   // Draw one frame of the animation into the LED array
   for (byte x = 0; x < kMatrixWidth; x++) {
@@ -89,19 +166,17 @@ void rider() {
     }
   }
 
-  riderPos++; // byte wraps to 0 at 255, triwave8 is also 0-255 periodic
+  effectState.rider.riderPos += frameTicks; // wraps to 0 at 255, triwave8 is also 0-255 periodic
 
 }
 
 
 // Shimmering noise, uses global hue cycle
-void glitter() {
+void glitterInit() {
+  effectDelay = 15;
+}
 
-  // startup tasks
-  if (effectInit == false) {
-    effectInit = true;
-    effectDelay = 15;
-  }
+void glitter() {
 
   // Draw one frame of the animation into the LED array
   for (int x = 0; x < kMatrixWidth; x++) {
@@ -114,21 +189,18 @@ void glitter() {
 
 
 // Fills saturated colors into the array from alternating directions
+void colorFillInit() {
+  effectDelay = 45;
+  effectKeepsFrame = true;
+  selectPalette(5); // rainbow, and saved as such
+}
+
 void colorFill() {
 
-  static byte currentColor = 0;
-  static byte currentRow = 0;
-  static byte currentDirection = 0;
-
-  // startup tasks
-  if (effectInit == false) {
-    effectInit = true;
-    effectDelay = 45;
-    currentColor = 0;
-    currentRow = 0;
-    currentDirection = 0;
-    currentPalette = RainbowColors_p;
-  }
+  colorFillState &state = effectState.colorFill;
+  byte &currentColor = state.currentColor;
+  byte &currentRow = state.currentRow;
+  byte &currentDirection = state.currentDirection;
 
   // test a bitmask to fill up or down when currentDirection is 0 or 2 (0b00 or 0b10)
   if (!(currentDirection & 1)) {
@@ -166,14 +238,9 @@ void colorFill() {
 }
 
 // Emulate 3D anaglyph glasses
-void threeDee() {
-
-  // startup tasks
-  if (effectInit == false) {
-    effectInit = true;
-    effectDelay = 50;
-  }
-
+// The image never changes, so it is drawn once; it is only redrawn while
+// a crossfade blends it in place on the bigger layouts (see crossfade.h)
+void drawThreeDee() {
   for (byte x = 0; x < kMatrixWidth; x++) {
     for (byte y = 0; y < kMatrixHeight; y++) {
       if (x < 7) {
@@ -191,15 +258,23 @@ void threeDee() {
 
 }
 
+void threeDeeInit() {
+  effectDelay = 50;
+  drawThreeDee();
+}
+
+void threeDee() {
+  if (crossfadeActive && !crossfadeFullColor) drawThreeDee();
+}
+
 // Random pixels scroll sideways, uses current hue
 #define rainDir 0
-void sideRain() {
+void sideRainInit() {
+  effectDelay = 30;
+  effectKeepsFrame = true;
+}
 
-  // startup tasks
-  if (effectInit == false) {
-    effectInit = true;
-    effectDelay = 30;
-  }
+void sideRain() {
 
   scrollArray(rainDir);
   byte randPixel = random8(kMatrixHeight);
@@ -210,17 +285,19 @@ void sideRain() {
 
 // Pixels with random locations and random colors selected from a palette
 // Use with the fadeAll function to allow old pixels to decay
-void confetti() {
+void confettiInit() {
+  effectDelay = 10;
+  effectKeepsFrame = true;
+  selectRandomPalette();
+}
 
-  // startup tasks
-  if (effectInit == false) {
-    effectInit = true;
-    effectDelay = 10;
-    selectRandomPalette();
-  }
+void confetti() {
 
-  // scatter random colored pixels at several random coordinates
-  for (byte i = 0; i < 4; i++) {
+  // scatter random colored pixels at several random coordinates, four per frame
+  effectState.confetti.pixels += 4 * frameTicks;
+  byte count = effectState.confetti.pixels >> 8;
+  effectState.confetti.pixels &= 0xFF;
+  for (byte i = 0; i < count; i++) {
     leds[XY(random16(kMatrixWidth), random16(kMatrixHeight))] = ColorFromPalette(currentPalette, random16(255), 255); //CHSV(random16(255), 255, 255);
     random16_add_entropy(1);
   }
@@ -229,15 +306,13 @@ void confetti() {
 
 
 // Draw slanting bars scrolling across the array, uses current hue
-void slantBars() {
+void slantBarsInit() {
+  effectDelay = 5;
+}
 
-  static byte slantPos = 0;
+void slantBars() {
 
-  // startup tasks
-  if (effectInit == false) {
-    effectInit = true;
-    effectDelay = 5;
-  }
+  byte slantPos = effectState.slantBars.slantPos >> 8;
 
   for (byte x = 0; x < kMatrixWidth; x++) {
     for (byte y = 0; y < kMatrixHeight; y++) {
@@ -245,171 +320,178 @@ void slantBars() {
     }
   }
 
-  slantPos -= 4;
-
-}
-
-
-#define NORMAL 0
-#define RAINBOW 1
-#define charSpacing 2
-// Scroll a text string
-void scrollText(byte message, byte style, CRGB fgColor, CRGB bgColor) {
-  static byte currentMessageChar = 0;
-  static byte currentCharColumn = 0;
-  static byte paletteCycle = 0;
-  static CRGB currentColor;
-  static byte bitBuffer[16] = {0};
-  static byte bitBufferPointer = 0;
-
-  // startup tasks
-  if (effectInit == false) {
-    effectInit = true;
-    effectDelay = 35;
-    currentMessageChar = 0;
-    currentCharColumn = 0;
-    selectFlashString(message);
-    loadCharBuffer(loadStringChar(message, currentMessageChar));
-    currentPalette = RainbowColors_p;
-    for (byte i = 0; i < kMatrixWidth; i++) bitBuffer[i] = 0;
-  }
+  effectState.slantBars.slantPos -= 4 * frameTicks;
 
-  paletteCycle += 15;
+}
 
-  if (currentCharColumn < 5) { // characters are 5 pixels wide
-    bitBuffer[(bitBufferPointer + kMatrixWidth - 1) % kMatrixWidth] = charBuffer[currentCharColumn]; // character
-  } else {
-    bitBuffer[(bitBufferPointer + kMatrixWidth - 1) % kMatrixWidth] = 0; // space
-  }
 
-  CRGB pixelColor;
-  for (byte x = 0; x < kMatrixWidth; x++) {
-    for (byte y = 0; y < 5; y++) { // characters are 5 pixels tall
-      if (bitRead(bitBuffer[(bitBufferPointer + x) % kMatrixWidth], y) == 1) {
-        if (style == RAINBOW) {
-          pixelColor = ColorFromPalette(currentPalette, paletteCycle + y * 16, 255);
-        } else {
-          pixelColor = fgColor;
-        }
-      } else {
-        pixelColor = bgColor;
-      }
-      leds[XY(x, y)] = pixelColor;
-    }
-  }
+// Scroll a text string, see text.h
+void scrollTextInit(byte message) {
+  effectDelay = 35;
+  startText(effectState.scrollText, message);
+  selectPalette(5); // rainbow, and saved as such
+}
 
-  currentCharColumn++;
-  if (currentCharColumn > (4 + charSpacing)) {
-    currentCharColumn = 0;
-    currentMessageChar++;
-    char nextChar = loadStringChar(message, currentMessageChar);
-    if (nextChar == 0) { // null character at end of strong
-      currentMessageChar = 0;
-      nextChar = loadStringChar(message, currentMessageChar);
-    }
-    loadCharBuffer(nextChar);
-  }
+void scrollText(byte style, CRGB fgColor, CRGB bgColor) {
+  scrollTextState &state = effectState.scrollText;
+  state.paletteCycle += 15 * frameTicks;
+  scrollTextFrames(state);
+  drawText(state, style, fgColor, bgColor);
+}
 
-  bitBufferPointer++;
-  if (bitBufferPointer > 15) bitBufferPointer = 0;
 
+void scrollTextZeroInit() {
+  scrollTextInit(0);
 }
 
-
 void scrollTextZero() {
-  scrollText(0, NORMAL, CRGB::Red, CRGB::Black);
+  scrollText(NORMAL, CRGB::Red, CRGB::Black);
+}
+
+void scrollTextOneInit() {
+  scrollTextInit(1);
 }
 
 void scrollTextOne() {
-  scrollText(1, RAINBOW, 0, CRGB::Black);
+  scrollText(RAINBOW, 0, CRGB::Black);
+}
+
+void scrollTextTwoInit() {
+  scrollTextInit(2);
 }
 
 void scrollTextTwo() {
-  scrollText(2, NORMAL, CRGB::Green, CRGB(0, 0, 8));
+  scrollText(NORMAL, CRGB::Green, CRGB(0, 0, 8));
 }
 
-#define analyzerFadeFactor 5
-#define analyzerScaleFactor 1.5
-#define analyzerPaletteFactor 2
-int panel[16] = {0};
-long unsigned updated;
+// Bar rasterizer for the analyzer and VU effects
+// A bar's sense value falls by the same step from each cell to the next,
+// so barRamp() runs it down in 8.8 fixed point. Brightness is the sense
+// value times fade and the palette index the sense value times
+// paletteMul / paletteDiv, less offset. Cells past both limits all get the
+// color passed in as full and cells at 0 or below are black, which leaves
+// a palette lookup for only the few cells in between.
+struct barStyle {
+  byte fade;
+  byte paletteMul;
+  byte paletteDiv;
+  byte offset;
+  unsigned int fullSense; // lowest sense value at full brightness and palette index 240
+};
+
+constexpr unsigned int barFullSense(byte fade, byte paletteMul, byte paletteDiv, byte offset) {
+  return (255 + fade - 1) / fade > ((240 + offset) * paletteDiv + paletteMul - 1) / paletteMul ?
+         (255 + fade - 1) / fade : ((240 + offset) * paletteDiv + paletteMul - 1) / paletteMul;
+}
 
-void crawlAnalyzer() {
-  // startup tasks
-  if (effectInit == false) {
-    effectInit = true;
-    effectDelay = 10;
-    selectRandomAudioPalette();
-  }
-  CRGB pixelColor;
-  long unsigned now = millis();
+#define BARSTYLE(fade, paletteMul, paletteDiv, offset) \
+  {fade, paletteMul, paletteDiv, offset, barFullSense(fade, paletteMul, paletteDiv, offset)}
 
-  if (now - updated > 50) {
-    panel[0] = spectrumDecay[0];
-    for (byte x = kMatrixWidth; x > 0; x--) {
-      panel[x] = panel[x - 1];
-    }
-    updated = millis();
-  }
-  const float yScale = 255.0 / kMatrixHeight;
+const barStyle analyzerBar = BARSTYLE(5, 1, 2, 15);  // level / 2 - 15
+const barStyle waterfallBar = BARSTYLE(1, 1, 2, 0);
+const barStyle VUBar = BARSTYLE(5, 2, 3, 15);        // level / 1.5 - 15
 
-  for (byte x = 0; x < kMatrixWidth ; x++) {
-    int freqVal = panel[x];
-    for (byte y = 0; y < kMatrixHeight; y++) {
+CRGB barColor(int sense, const barStyle &style) {
+  if (sense <= 0) return CRGB::Black;
+  unsigned int brightness = sense * style.fade;
+  int paletteIndex = sense * style.paletteMul / style.paletteDiv - style.offset;
+  if (paletteIndex > 240) paletteIndex = 240;
+  if (paletteIndex < 0) paletteIndex = 0;
+  return ColorFromPalette(currentPalette, paletteIndex, brightness > 255 ? 255 : brightness);
+}
 
-      int senseValue = freqVal / analyzerScaleFactor - yScale * (kMatrixHeight - 1 - y);
-      int pixelBrightness = senseValue * analyzerFadeFactor;
-      if (pixelBrightness > 255) pixelBrightness = 255;
-      if (pixelBrightness < 0) pixelBrightness = 0;
+CRGB barFullColor() {
+  return ColorFromPalette(currentPalette, 240, 255);
+}
 
-      int pixelPaletteIndex = senseValue / analyzerPaletteFactor - 15;
-      if (pixelPaletteIndex > 240) pixelPaletteIndex = 240;
-      if (pixelPaletteIndex < 0) pixelPaletteIndex = 0;
+// Colors of count cells from a sense value of level, falling by step
+void barRamp(CRGB *cells, byte count, long level, uint16_t step, const barStyle &style, const CRGB &full) {
+  byte i = 0;
+  long fullLevel = (long)style.fullSense << 8;
+  for (; i < count && level >= fullLevel; i++, level -= step) cells[i] = full;
+  for (; i < count && level >= 256; i++, level -= step) cells[i] = barColor(level >> 8, style);
+  for (; i < count; i++) cells[i] = CRGB::Black;
+}
 
-      pixelColor = ColorFromPalette(currentPalette, pixelPaletteIndex, pixelBrightness);
+// Sense value falling by 255 over count cells, 8.8 fixed point
+constexpr uint16_t barStep(byte count) {
+  return (255 * 256L + count / 2) / count;
+}
 
-      leds[XY(x, y)] = pixelColor;
-    }
-  }
+// Analyzer columns rise from the bottom at 1/1.5 of the band level
+long analyzerLevel(long value) {
+  return value * 512 / 3;
 }
 
-#define analyzerFadeFactor 5
-#define analyzerScaleFactor 1.5
-#define analyzerPaletteFactor 2
-void drawAnalyzer() {
-  // startup tasks
-  if (effectInit == false) {
-    effectInit = true;
-    effectDelay = 10;
-    selectRandomAudioPalette();
+// VU effects show the average of the lower four bands at half level, 8.8 fixed point
+long VULevel() {
+  return (long)(spectrumDecay[0] + spectrumDecay[1] + spectrumDecay[2] + spectrumDecay[3]) * 32;
+}
+
+void crawlAnalyzerInit() {
+  effectDelay = 10;
+  selectRandomAudioPalette();
+  effectState.history.pushMicros = micros(); // first push one period from now
+}
+
+void crawlAnalyzer() {
+  spectrogram &history = effectState.history;
+  CRGB cells[kMatrixHeight];
+  CRGB full = barFullColor();
+
+  updateSpectrogram(history, 50);
+
+  for (byte x = 0; x < kMatrixWidth ; x++) {
+    barRamp(cells, kMatrixHeight, analyzerLevel(spectrogramLevel(history, x, 0)), barStep(kMatrixHeight), analyzerBar, full);
+    for (byte y = 0; y < kMatrixHeight; y++) leds[XY(x, y)] = cells[kMatrixHeight - 1 - y];
   }
+}
 
-  CRGB pixelColor;
+// Spectrogram scrolling down from the top, bands from left (bass) to right
+void waterfallInit() {
+  effectDelay = 10;
+  selectRandomAudioPalette();
+  effectState.history.pushMicros = micros(); // first push one period from now
+}
 
-  const float yScale = 255.0 / kMatrixHeight;
+void waterfall() {
+  spectrogram &history = effectState.history;
+  CRGB bandColors[7];
 
-  for (byte x = 0; x < kMatrixWidth / 2; x++) {
-    byte newX = x;
-    int freqVal;
-    if (x < 2) {
-      newX = 0;
-      freqVal = spectrumDecay[newX];
-    } else {
-      newX = x - 1;
-      freqVal = spectrumDecay[newX];
+  updateSpectrogram(history, 50);
+
+  for (byte y = 0; y < kMatrixHeight; y++) {
+    const byte *levels = spectrogramRow(history, y);
+    for (byte band = 0; band < 7; band++) bandColors[band] = barColor(analyzerLevel(levels[band] << 1) >> 8, waterfallBar);
+
+    // band = x * 7 / kMatrixWidth, counted up
+    byte band = 0;
+    byte remainder = 0;
+    for (byte x = 0; x < kMatrixWidth; x++) {
+      leds[XY(x, y)] = bandColors[band];
+      remainder += 7;
+      while (remainder >= kMatrixWidth) {
+        remainder -= kMatrixWidth;
+        band++;
+      }
     }
+  }
+}
 
-    for (byte y = 0; y < kMatrixHeight; y++) {
-      int senseValue = freqVal / analyzerScaleFactor - yScale * (kMatrixHeight - 1 - y);
-      int pixelBrightness = senseValue * analyzerFadeFactor;
-      if (pixelBrightness > 255) pixelBrightness = 255;
-      if (pixelBrightness < 0) pixelBrightness = 0;
+void drawAnalyzerInit() {
+  effectDelay = 10;
+  selectRandomAudioPalette();
+}
 
-      int pixelPaletteIndex = senseValue / analyzerPaletteFactor - 15;
-      if (pixelPaletteIndex > 240) pixelPaletteIndex = 240;
-      if (pixelPaletteIndex < 0) pixelPaletteIndex = 0;
+// Mirrored analyzer, the bass band is two columns wide
+void drawAnalyzer() {
+  CRGB cells[kMatrixHeight];
+  CRGB full = barFullColor();
 
-      pixelColor = ColorFromPalette(currentPalette, pixelPaletteIndex, pixelBrightness);
+  for (byte x = 0; x < kMatrixWidth / 2; x++) {
+    if (x != 1) barRamp(cells, kMatrixHeight, analyzerLevel(spectrumDecay[x < 2 ? 0 : x - 1]), barStep(kMatrixHeight), analyzerBar, full);
+    for (byte y = 0; y < kMatrixHeight; y++) {
+      const CRGB &pixelColor = cells[kMatrixHeight - 1 - y];
       leds[XY(x, y)] = pixelColor;
       leds[XY(kMatrixWidth - x - 1, y)] = pixelColor;
     }
@@ -422,37 +504,19 @@ void drawAnalyzer() {
 
 }
 
-#define VUFadeFactor 5
-#define VUScaleFactor 2.0
-#define VUPaletteFactor 1.5
-void drawVU() {
-  // startup tasks
-  if (effectInit == false) {
-    effectInit = true;
-    effectDelay = 10;
-    selectRandomAudioPalette();
-  }
-
-  CRGB pixelColor;
+void drawVUInit() {
+  effectDelay = 10;
+  selectRandomAudioPalette();
+}
 
-  const float xScale = 255.0 / (kMatrixWidth / 2);
-  float specCombo = (spectrumDecay[0] + spectrumDecay[1] + spectrumDecay[2] + spectrumDecay[3]) / 4.0;
+void drawVU() {
+  CRGB cells[kMatrixWidth / 2];
+  barRamp(cells, kMatrixWidth / 2, VULevel(), barStep(kMatrixWidth / 2), VUBar, barFullColor());
 
   for (byte x = 0; x < kMatrixWidth / 2; x++) {
-    int senseValue = specCombo / VUScaleFactor - xScale * x;
-    int pixelBrightness = senseValue * VUFadeFactor;
-    if (pixelBrightness > 255) pixelBrightness = 255;
-    if (pixelBrightness < 0) pixelBrightness = 0;
-
-    int pixelPaletteIndex = senseValue / VUPaletteFactor - 15;
-    if (pixelPaletteIndex > 240) pixelPaletteIndex = 240;
-    if (pixelPaletteIndex < 0) pixelPaletteIndex = 0;
-
-    pixelColor = ColorFromPalette(currentPalette, pixelPaletteIndex, pixelBrightness);
-
     for (byte y = 0; y < kMatrixHeight; y++) {
-      leds[XY(x, y)] = pixelColor;
-      leds[XY(kMatrixWidth - x - 1, y)] = pixelColor;
+      leds[XY(x, y)] = cells[x];
+      leds[XY(kMatrixWidth - x - 1, y)] = cells[x];
     }
   }
 
@@ -464,109 +528,88 @@ void drawVU() {
 }
 
 
-//void RGBpulse() {
-//
-//  // startup tasks
-//  if (effectInit == false) {
-//    effectInit = true;
-//    effectDelay = 1;
-//  }
-//
-//  static byte RGBcycle = 0;
-//
-//  fadeAll(1);
-//
-//  if (beatDetect()) {
-//
-//    switch (RGBcycle) {
-//      case 0:
-//        fillAll(CRGB::Red);
-//        break;
-//      case 1:
-//        fillAll(CRGB::Lime);
-//        break;
-//      case 2:
-//        fillAll(CRGB::Blue);
-//        break;
-//    }
-//
-//    RGBcycle++;
-//    if (RGBcycle > 2) RGBcycle = 0;
-//  }
-//
-//}
-
-const int heart0[] = {94, 95, 108, 109, 123, 124};
-const int heart1[] = {78, 79, 80, 93, 96, 107, 110, 122, 125, 136, 137, 138};
-const int heart2[] = {65, 66, 67, 77, 81, 92, 111, 121, 135, 139, 152, 153, 154};
-const int heart3[] = {48, 49, 50, 51, 64, 68, 76, 82, 91, 97, 106, 112, 120, 126, 134, 140, 151, 155, 164, 165, 166, 167};
-const int heart4[] = {36, 37, 38, 39, 47, 52, 63, 69, 83, 90, 113, 119, 141, 150, 156, 163, 168, 181, 182, 183, 184};
-const int heart5[] = {18, 19, 20, 21, 35, 40, 46, 53, 62, 70, 75, 84, 89, 98, 105, 114, 118, 127, 133, 142, 149, 157, 162, 169, 180, 185, 192, 193, 194, 195};
-const int heart6[] = {8, 9, 10, 11, 17, 22, 34, 41, 45, 54, 61, 71, 74, 85, 88, 99, 104, 115, 117, 128, 132, 143, 148, 158, 161, 170, 179, 186, 191, 196, 211, 212, 213, 214};
-
-void heartPulse() {
-  // startup tasks
-  if (effectInit == false) {
-    effectInit = true;
-    effectDelay = 10;
-    selectRandomAudioPalette();
-    for (int i = 0; i < 218; i++) leds[i] = CRGB::Black;
-  }
-
-  CRGB pixelColor;
+// Flash the whole display on every beat
+// Follows the tempo (beat.h) when there is one, so the flashes stay on the
+// beat through quiet parts, and single onsets otherwise
+void RGBpulseInit() {
+  effectDelay = 4;
+  effectKeepsFrame = true;
+}
 
-  const float xScale = 255.0 / 7;
-  float specCombo = (spectrumDecay[0] + spectrumDecay[1] + spectrumDecay[2] + spectrumDecay[3]) / 4.0;
+void RGBpulse() {
 
-  for (byte x = 0; x < 7; x++) {
-    int senseValue = specCombo / VUScaleFactor - xScale * x;
-    int pixelBrightness = senseValue * VUFadeFactor;
-    if (pixelBrightness > 255) pixelBrightness = 255;
-    if (pixelBrightness < 0) pixelBrightness = 0;
+  boolean pulse = beatDetect(); // read every frame, so an old onset does not flash later
+  if (beatsPerMinute != 0) pulse = beatCount != effectState.rgbPulse.lastBeat;
+  effectState.rgbPulse.lastBeat = beatCount;
 
-    int pixelPaletteIndex = senseValue / VUPaletteFactor - 15;
-    if (pixelPaletteIndex > 240) pixelPaletteIndex = 240;
-    if (pixelPaletteIndex < 0) pixelPaletteIndex = 0;
+  uint16_t fade = frameTicks >> 6; // the display fades out in about a quarter second
+  fadeAll(fade > 255 ? 255 : fade);
 
-    pixelColor = ColorFromPalette(currentPalette, pixelPaletteIndex, pixelBrightness);
+  if (pulse) {
 
-    switch (x) {
+    switch (effectState.rgbPulse.RGBcycle) {
       case 0:
-        for (int i = 0; i < 6; i++) {
-          leds[heart0[i]] = pixelColor;
-        }
+        fillAll(CRGB::Red);
         break;
       case 1:
-        for (int i = 0; i < 12; i++) {
-          leds[heart1[i]] = pixelColor;
-        }
+        fillAll(CRGB::Lime);
         break;
       case 2:
-        for (int i = 0; i < 13; i++) {
-          leds[heart2[i]] = pixelColor;
-        }
-        break;
-      case 3:
-        for (int i = 0; i < 22; i++) {
-          leds[heart3[i]] = pixelColor;
-        }
-        break;
-      case 4:
-        for (int i = 0; i < 21; i++) {
-          leds[heart4[i]] = pixelColor;
-        }
-        break;
-      case 5:
-        for (int i = 0; i < 30; i++) {
-          leds[heart5[i]] = pixelColor;
-        }
-        break;
-      case 6:
-        for (int i = 0; i < 34; i++) {
-          leds[heart6[i]] = pixelColor;
-        }
+        fillAll(CRGB::Blue);
         break;
     }
+
+    effectState.rgbPulse.RGBcycle++;
+    if (effectState.rgbPulse.RGBcycle > 2) effectState.rgbPulse.RGBcycle = 0;
+  }
+
+}
+
+// Concentric VU rings from a ring map (ringmap.h)
+// The color of each ring is worked out once, then leds[] is filled in one
+// pass in strip order. Rings past levels stay dark.
+#define RINGMAXLEVELS 16
+
+void drawRings(const ringTableType &map, byte levels) {
+  if (levels > RINGMAXLEVELS) levels = RINGMAXLEVELS;
+  CRGB ringColors[RINGMAXLEVELS];
+  barRamp(ringColors, levels, VULevel(), barStep(levels), VUBar, barFullColor());
+
+  ledindex_t i = 0;
+  for (unsigned int position = 0; position < NUM_LEDS; position++) {
+    byte ring = pgm_read_byte(&map.ring[position]);
+    if (ring == RINGHOLE) continue;
+    leds[i++] = ring < levels ? ringColors[ring] : CRGB(CRGB::Black);
   }
 }
 
+// VU meter as a heart growing from the middle
+void heartPulseInit() {
+  effectDelay = 10;
+  selectRandomAudioPalette();
+}
+
+void heartPulse() {
+  drawRings(ringHeart, ringLevels(RING_HEART));
+}
+
+// VU meter as circles
+void circlePulseInit() {
+  effectDelay = 10;
+  selectRandomAudioPalette();
+}
+
+void circlePulse() {
+  drawRings(ringCircle, ringLevels(RING_CIRCLE));
+}
+
+// VU meter as diamonds
+void diamondPulseInit() {
+  effectDelay = 10;
+  selectRandomAudioPalette();
+}
+
+void diamondPulse() {
+  drawRings(ringDiamond, ringLevels(RING_DIAMOND));
+}
+
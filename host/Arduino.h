@@ -0,0 +1,171 @@
+// Minimal Arduino core stand-in for building the sketch on a desktop host
+//
+// Time is simulated: millis() and micros() read hostMicros, which only moves
+// when the simulator advances it or the sketch calls delay(). Pins, the ADC
+// and the serial port are forwarded to host* hooks defined by the program
+// that includes the sketch (see sim.cpp).
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define DEFAULT 1
+
+// Flash access is plain memory access off the device
+#define PROGMEM
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_byte_near(addr) pgm_read_byte(addr)
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+#define pgm_read_ptr(addr) (*(const void * const *)(addr))
+#define memcpy_P memcpy
+
+#define bitRead(value, bit) (((value) >> (bit)) & 0x01)
+#define sq(x) ((x) * (x))
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+inline long map(long x, long inMin, long inMax, long outMin, long outMax) {
+  return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+// Simulated clock, in microseconds since power up
+extern unsigned long hostMicros;
+
+inline unsigned long micros() {
+  return hostMicros;
+}
+
+inline unsigned long millis() {
+  return hostMicros / 1000;
+}
+
+inline void delay(unsigned long ms) {
+  hostMicros += ms * 1000;
+}
+
+inline void delayMicroseconds(unsigned int us) {
+  hostMicros += us;
+}
+
+// Pin and ADC hooks
+int hostDigitalRead(uint8_t pin);
+void hostDigitalWrite(uint8_t pin, uint8_t value);
+int hostAnalogRead(uint8_t pin);
+
+inline void pinMode(uint8_t pin, uint8_t mode) {}
+inline void analogReference(uint8_t mode) {}
+
+inline int digitalRead(uint8_t pin) {
+  return hostDigitalRead(pin);
+}
+
+inline void digitalWrite(uint8_t pin, uint8_t value) {
+  hostDigitalWrite(pin, value);
+}
+
+inline int analogRead(uint8_t pin) {
+  return hostAnalogRead(pin);
+}
+
+// Strings in flash are ordinary strings off the device
+class __FlashStringHelper;
+#define F(string) ((const __FlashStringHelper *)(string))
+
+// Serial port hooks
+void hostSerialBegin(unsigned long baud);
+int hostSerialRead();
+void hostSerialWrite(const uint8_t *data, size_t length);
+
+class HardwareSerial {
+  public:
+    void begin(unsigned long baud) {
+      hostSerialBegin(baud);
+    }
+    void flush() {}
+
+    int available() {
+      int c = peek();
+      return c < 0 ? 0 : 1;
+    }
+
+    int peek() {
+      if (pending < 0) pending = hostSerialRead();
+      return pending;
+    }
+
+    int read() {
+      int c = peek();
+      pending = -1;
+      return c;
+    }
+
+    size_t write(uint8_t c) {
+      hostSerialWrite(&c, 1);
+      return 1;
+    }
+
+    size_t write(const uint8_t *data, size_t length) {
+      hostSerialWrite(data, length);
+      return length;
+    }
+
+    size_t print(const char *text) {
+      return write((const uint8_t *)text, strlen(text));
+    }
+
+    size_t print(const __FlashStringHelper *text) {
+      return print((const char *)text);
+    }
+
+    size_t print(char c) {
+      return write((uint8_t)c);
+    }
+
+    size_t print(long value) {
+      char text[24];
+      snprintf(text, sizeof(text), "%ld", value);
+      return print(text);
+    }
+
+    size_t print(unsigned long value) {
+      char text[24];
+      snprintf(text, sizeof(text), "%lu", value);
+      return print(text);
+    }
+
+    size_t print(int value) {
+      return print((long)value);
+    }
+
+    size_t print(unsigned int value) {
+      return print((unsigned long)value);
+    }
+
+    size_t println() {
+      return print("\r\n");
+    }
+
+    template <typename T> size_t println(T value) {
+      size_t n = print(value);
+      return n + println();
+    }
+
+  private:
+    int pending = -1;
+};
+
+extern HardwareSerial Serial;
+
+#endif
@@ -0,0 +1,46 @@
+// Minimal EEPROM library stand-in for building the sketch on a desktop host
+//
+// 1KB like the ATmega328, erased to 0xFF. The simulator can load and save
+// the contents so settings survive between runs; the settings test cuts
+// saves short with writesLeft.
+
+#ifndef HOST_EEPROM_H
+#define HOST_EEPROM_H
+
+#include "Arduino.h"
+
+#define E2END 0x3FF
+
+class EEPROMClass {
+  public:
+    EEPROMClass() {
+      memset(data, 0xFF, sizeof(data));
+    }
+
+    uint8_t read(int address) {
+      return data[address & E2END];
+    }
+
+    void write(int address, uint8_t value) {
+      if (writesLeft == 0) return; // power is gone
+      if (writesLeft > 0) writesLeft--;
+      data[address & E2END] = value;
+      writes++;
+    }
+
+    void update(int address, uint8_t value) {
+      if (read(address) != value) write(address, value);
+    }
+
+    uint16_t length() {
+      return E2END + 1;
+    }
+
+    uint8_t data[E2END + 1];
+    unsigned long writes = 0; // cell writes since power up, for wear checks
+    long writesLeft = -1; // cell writes before a simulated power loss, -1 for none
+};
+
+extern EEPROMClass EEPROM;
+
+#endif
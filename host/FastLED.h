@@ -0,0 +1,499 @@
+// Minimal FastLED stand-in for building the sketch on a desktop host
+//
+// Covers the parts of FastLED 3.x the sketch uses: CRGB/CHSV with the
+// rainbow hue mapping, the 8 bit math helpers, the random generator, the
+// stock 16 entry palettes and ColorFromPalette(). The math follows the
+// FastLED C fallbacks so rendered frames match the device closely.
+// FastLED.show() hands the frame to hostShow(), defined by the simulator.
+
+#ifndef HOST_FASTLED_H
+#define HOST_FASTLED_H
+
+#include "Arduino.h"
+
+typedef uint8_t fract8;
+
+// 8 bit math
+
+inline uint8_t scale8(uint8_t i, fract8 scale) {
+  return ((uint16_t)i * (1 + (uint16_t)scale)) >> 8;
+}
+
+inline uint8_t scale8_video(uint8_t i, fract8 scale) {
+  return (((int)i * (int)scale) >> 8) + ((i && scale) ? 1 : 0);
+}
+
+inline uint16_t scale16(uint16_t i, uint16_t scale) {
+  return ((uint32_t)i * (1 + (uint32_t)scale)) >> 16;
+}
+
+inline uint8_t qadd8(uint8_t i, uint8_t j) {
+  unsigned int t = i + j;
+  return t > 255 ? 255 : t;
+}
+
+inline uint8_t qsub8(uint8_t i, uint8_t j) {
+  return i > j ? i - j : 0;
+}
+
+inline uint8_t qmul8(uint8_t i, uint8_t j) {
+  unsigned int p = (unsigned int)i * j;
+  return p > 255 ? 255 : p;
+}
+
+inline uint8_t blend8(uint8_t a, uint8_t b, uint8_t amountOfB) {
+  uint16_t partial = (a << 8) | b;
+  partial += (b * amountOfB);
+  partial -= (a * amountOfB);
+  return partial >> 8;
+}
+
+inline uint8_t sqrt16(uint16_t x) {
+  if (x <= 1) return x;
+  uint8_t low = 1;
+  uint8_t hi, mid;
+  if (x > 7904) {
+    hi = 255;
+  } else {
+    hi = (x >> 5) + 8;
+  }
+  do {
+    mid = (low + hi) >> 1;
+    if ((uint16_t)(mid * mid) > x) {
+      hi = mid - 1;
+    } else {
+      if (mid == 255) return 255;
+      low = mid + 1;
+    }
+  } while (hi >= low);
+  return low - 1;
+}
+
+inline uint8_t sin8(uint8_t theta) {
+  static const uint8_t b_m16_interleave[] = {0, 49, 49, 41, 90, 27, 117, 10};
+  uint8_t offset = theta;
+  if (theta & 0x40) offset = (uint8_t)255 - offset;
+  offset &= 0x3F;
+  uint8_t secoffset = offset & 0x0F;
+  if (theta & 0x40) secoffset++;
+  uint8_t section = offset >> 4;
+  uint8_t b = b_m16_interleave[section * 2];
+  uint8_t m16 = b_m16_interleave[section * 2 + 1];
+  uint8_t mx = (m16 * secoffset) >> 4;
+  int8_t y = mx + b;
+  if (theta & 0x80) y = -y;
+  y += 128;
+  return y;
+}
+
+inline uint8_t cos8(uint8_t theta) {
+  return sin8(theta + 64);
+}
+
+inline uint8_t triwave8(uint8_t in) {
+  if (in & 0x80) in = 255 - in;
+  return in << 1;
+}
+
+inline uint8_t ease8InOutQuad(uint8_t i) {
+  uint8_t j = i;
+  if (j & 0x80) j = 255 - j;
+  uint8_t jj = scale8(j, j);
+  uint8_t jj2 = jj << 1;
+  if (i & 0x80) jj2 = 255 - jj2;
+  return jj2;
+}
+
+inline uint8_t quadwave8(uint8_t in) {
+  return ease8InOutQuad(triwave8(in));
+}
+
+// Random numbers, same generator and seed as FastLED
+
+extern uint16_t rand16seed;
+
+inline uint8_t random8() {
+  rand16seed = (rand16seed * 2053) + 13849;
+  return (uint8_t)(((uint8_t)(rand16seed & 0xFF)) + ((uint8_t)(rand16seed >> 8)));
+}
+
+inline uint8_t random8(uint8_t lim) {
+  return (random8() * lim) >> 8;
+}
+
+inline uint8_t random8(uint8_t min, uint8_t lim) {
+  return random8(lim - min) + min;
+}
+
+inline uint16_t random16() {
+  rand16seed = (rand16seed * 2053) + 13849;
+  return rand16seed;
+}
+
+inline uint16_t random16(uint16_t lim) {
+  return ((uint32_t)random16() * lim) >> 16;
+}
+
+inline uint16_t random16(uint16_t min, uint16_t lim) {
+  return random16(lim - min) + min;
+}
+
+inline void random16_add_entropy(uint16_t entropy) {
+  rand16seed += entropy;
+}
+
+// Colors
+
+struct CHSV {
+  uint8_t hue;
+  uint8_t sat;
+  uint8_t val;
+
+  CHSV() {}
+  CHSV(uint8_t h, uint8_t s, uint8_t v) : hue(h), sat(s), val(v) {}
+};
+
+struct CRGB;
+void hsv2rgb_rainbow(const CHSV &hsv, CRGB &rgb);
+
+struct CRGB {
+  union {
+    struct {
+      uint8_t r;
+      uint8_t g;
+      uint8_t b;
+    };
+    uint8_t raw[3];
+  };
+
+  typedef enum {
+    Aqua = 0x00FFFF,
+    Aquamarine = 0x7FFFD4,
+    Black = 0x000000,
+    Blue = 0x0000FF,
+    CadetBlue = 0x5F9EA0,
+    CornflowerBlue = 0x6495ED,
+    Cyan = 0x00FFFF,
+    DarkBlue = 0x00008B,
+    DarkCyan = 0x008B8B,
+    DarkGreen = 0x006400,
+    DarkOliveGreen = 0x556B2F,
+    DarkOrange = 0xFF8C00,
+    DarkRed = 0x8B0000,
+    ForestGreen = 0x228B22,
+    Gold = 0xFFD700,
+    Gray = 0x808080,
+    Green = 0x008000,
+    Grey = 0x808080,
+    LawnGreen = 0x7CFC00,
+    LightBlue = 0xADD8E6,
+    LightGreen = 0x90EE90,
+    LightGrey = 0xD3D3D3,
+    LightSkyBlue = 0x87CEFA,
+    Lime = 0x00FF00,
+    LimeGreen = 0x32CD32,
+    Magenta = 0xFF00FF,
+    Maroon = 0x800000,
+    MediumAquamarine = 0x66CDAA,
+    MediumBlue = 0x0000CD,
+    MidnightBlue = 0x191970,
+    Navy = 0x000080,
+    OliveDrab = 0x6B8E23,
+    Orange = 0xFFA500,
+    PaleGreen = 0x98FB98,
+    Pink = 0xFFC0CB,
+    Purple = 0x800080,
+    Red = 0xFF0000,
+    SeaGreen = 0x2E8B57,
+    SkyBlue = 0x87CEEB,
+    Teal = 0x008080,
+    White = 0xFFFFFF,
+    Yellow = 0xFFFF00,
+    YellowGreen = 0x9ACD32
+  } HTMLColorCode;
+
+  CRGB() {}
+  CRGB(uint8_t ir, uint8_t ig, uint8_t ib) : r(ir), g(ig), b(ib) {}
+  CRGB(uint32_t colorcode) : r((colorcode >> 16) & 0xFF), g((colorcode >> 8) & 0xFF), b(colorcode & 0xFF) {}
+  CRGB(HTMLColorCode colorcode) : CRGB((uint32_t)colorcode) {}
+  CRGB(const CHSV &hsv) {
+    hsv2rgb_rainbow(hsv, *this);
+  }
+
+  uint8_t &operator[](uint8_t x) {
+    return raw[x];
+  }
+
+  const uint8_t &operator[](uint8_t x) const {
+    return raw[x];
+  }
+
+  CRGB &nscale8(uint8_t scaledown) {
+    r = scale8(r, scaledown);
+    g = scale8(g, scaledown);
+    b = scale8(b, scaledown);
+    return *this;
+  }
+
+  CRGB &fadeToBlackBy(uint8_t fadefactor) {
+    return nscale8(255 - fadefactor);
+  }
+
+  CRGB &operator+=(const CRGB &rhs) {
+    r = qadd8(r, rhs.r);
+    g = qadd8(g, rhs.g);
+    b = qadd8(b, rhs.b);
+    return *this;
+  }
+
+  bool operator==(const CRGB &rhs) const {
+    return r == rhs.r && g == rhs.g && b == rhs.b;
+  }
+
+  bool operator!=(const CRGB &rhs) const {
+    return !(*this == rhs);
+  }
+};
+
+inline void hsv2rgb_rainbow(const CHSV &hsv, CRGB &rgb) {
+  uint8_t hue = hsv.hue;
+  uint8_t sat = hsv.sat;
+  uint8_t val = hsv.val;
+
+  uint8_t offset8 = (hue & 0x1F) << 3;
+  uint8_t third = scale8(offset8, (256 / 3));
+  uint8_t twothirds = scale8(offset8, ((256 * 2) / 3));
+  uint8_t r, g, b;
+
+  if (!(hue & 0x80)) {
+    if (!(hue & 0x40)) {
+      if (!(hue & 0x20)) {
+        r = 255 - third; g = third; b = 0;       // red to orange
+      } else {
+        r = 171; g = 85 + third; b = 0;          // orange to yellow
+      }
+    } else {
+      if (!(hue & 0x20)) {
+        r = 171 - twothirds; g = 170 + third; b = 0; // yellow to green
+      } else {
+        r = 0; g = 255 - third; b = third;       // green to aqua
+      }
+    }
+  } else {
+    if (!(hue & 0x40)) {
+      if (!(hue & 0x20)) {
+        r = 0; g = 171 - twothirds; b = 85 + twothirds; // aqua to blue
+      } else {
+        r = third; g = 0; b = 255 - third;       // blue to purple
+      }
+    } else {
+      if (!(hue & 0x20)) {
+        r = 85 + third; g = 0; b = 171 - third;  // purple to pink
+      } else {
+        r = 170 + third; g = 0; b = 85 - third;  // pink to red
+      }
+    }
+  }
+
+  if (sat != 255) {
+    if (sat == 0) {
+      r = 255; g = 255; b = 255;
+    } else {
+      uint8_t desat = 255 - sat;
+      desat = scale8_video(desat, desat);
+      uint8_t satscale = 255 - desat;
+      if (r) r = scale8(r, satscale) + 1;
+      if (g) g = scale8(g, satscale) + 1;
+      if (b) b = scale8(b, satscale) + 1;
+      r += desat;
+      g += desat;
+      b += desat;
+    }
+  }
+
+  if (val != 255) {
+    val = scale8_video(val, val);
+    if (val == 0) {
+      r = 0; g = 0; b = 0;
+    } else {
+      if (r) r = scale8(r, val) + 1;
+      if (g) g = scale8(g, val) + 1;
+      if (b) b = scale8(b, val) + 1;
+    }
+  }
+
+  rgb.r = r;
+  rgb.g = g;
+  rgb.b = b;
+}
+
+inline CRGB blend(const CRGB &p1, const CRGB &p2, fract8 amountOfP2) {
+  return CRGB(blend8(p1.r, p2.r, amountOfP2), blend8(p1.g, p2.g, amountOfP2), blend8(p1.b, p2.b, amountOfP2));
+}
+
+inline CRGB &nblend(CRGB &existing, const CRGB &overlay, fract8 amountOfOverlay) {
+  existing = blend(existing, overlay, amountOfOverlay);
+  return existing;
+}
+
+// Palettes
+
+typedef uint32_t TProgmemRGBPalette16[16];
+
+typedef enum { NOBLEND = 0, LINEARBLEND = 1 } TBlendType;
+
+inline void fill_gradient_RGB(CRGB *leds, uint16_t startpos, CRGB startcolor, uint16_t endpos, CRGB endcolor) {
+  if (endpos < startpos) {
+    uint16_t t = endpos; endpos = startpos; startpos = t;
+    CRGB tc = endcolor; endcolor = startcolor; startcolor = tc;
+  }
+  uint16_t distance = endpos - startpos;
+  for (uint16_t i = startpos; i <= endpos; i++) {
+    uint8_t f = distance ? ((i - startpos) * 255) / distance : 0;
+    leds[i] = blend(startcolor, endcolor, f);
+  }
+}
+
+struct CRGBPalette16 {
+  CRGB entries[16];
+
+  CRGBPalette16() {}
+
+  CRGBPalette16(const TProgmemRGBPalette16 &rhs) {
+    for (uint8_t i = 0; i < 16; i++) entries[i] = CRGB(rhs[i]);
+  }
+
+  CRGBPalette16(const CRGB &c1, const CRGB &c2) {
+    fill_gradient_RGB(entries, 0, c1, 15, c2);
+  }
+
+  CRGBPalette16(const CRGB &c1, const CRGB &c2, const CRGB &c3) {
+    fill_gradient_RGB(entries, 0, c1, 7, c2);
+    fill_gradient_RGB(entries, 7, c2, 15, c3);
+  }
+
+  CRGBPalette16(const CRGB &c1, const CRGB &c2, const CRGB &c3, const CRGB &c4) {
+    fill_gradient_RGB(entries, 0, c1, 5, c2);
+    fill_gradient_RGB(entries, 5, c2, 10, c3);
+    fill_gradient_RGB(entries, 10, c3, 15, c4);
+  }
+
+  CRGB &operator[](uint8_t x) {
+    return entries[x];
+  }
+
+  const CRGB &operator[](uint8_t x) const {
+    return entries[x];
+  }
+};
+
+inline CRGB ColorFromPalette(const CRGBPalette16 &pal, uint8_t index, uint8_t brightness = 255, TBlendType blendType = LINEARBLEND) {
+  uint8_t hi4 = index >> 4;
+  uint8_t lo4 = index & 0x0F;
+  CRGB color = pal[hi4];
+
+  if (lo4 && blendType != NOBLEND) {
+    const CRGB &next = pal[(hi4 + 1) & 0x0F];
+    uint8_t f2 = lo4 << 4;
+    uint8_t f1 = 255 - f2;
+    color.r = scale8(color.r, f1) + scale8(next.r, f2);
+    color.g = scale8(color.g, f1) + scale8(next.g, f2);
+    color.b = scale8(color.b, f1) + scale8(next.b, f2);
+  }
+
+  if (brightness != 255) {
+    color.nscale8(brightness);
+  }
+
+  return color;
+}
+
+const TProgmemRGBPalette16 CloudColors_p = {
+  CRGB::Blue, CRGB::DarkBlue, CRGB::DarkBlue, CRGB::DarkBlue,
+  CRGB::DarkBlue, CRGB::DarkBlue, CRGB::DarkBlue, CRGB::DarkBlue,
+  CRGB::Blue, CRGB::DarkBlue, CRGB::SkyBlue, CRGB::SkyBlue,
+  CRGB::LightBlue, CRGB::White, CRGB::LightBlue, CRGB::SkyBlue
+};
+
+const TProgmemRGBPalette16 LavaColors_p = {
+  CRGB::Black, CRGB::Maroon, CRGB::Black, CRGB::Maroon,
+  CRGB::DarkRed, CRGB::DarkRed, CRGB::Maroon, CRGB::DarkRed,
+  CRGB::DarkRed, CRGB::DarkRed, CRGB::Red, CRGB::Orange,
+  CRGB::White, CRGB::Orange, CRGB::Red, CRGB::DarkRed
+};
+
+const TProgmemRGBPalette16 OceanColors_p = {
+  CRGB::MidnightBlue, CRGB::DarkBlue, CRGB::MidnightBlue, CRGB::Navy,
+  CRGB::DarkBlue, CRGB::MediumBlue, CRGB::SeaGreen, CRGB::Teal,
+  CRGB::CadetBlue, CRGB::Blue, CRGB::DarkCyan, CRGB::CornflowerBlue,
+  CRGB::Aquamarine, CRGB::SeaGreen, CRGB::Aqua, CRGB::LightSkyBlue
+};
+
+const TProgmemRGBPalette16 ForestColors_p = {
+  CRGB::DarkGreen, CRGB::DarkGreen, CRGB::DarkOliveGreen, CRGB::DarkGreen,
+  CRGB::Green, CRGB::ForestGreen, CRGB::OliveDrab, CRGB::Green,
+  CRGB::SeaGreen, CRGB::MediumAquamarine, CRGB::LimeGreen, CRGB::YellowGreen,
+  CRGB::LightGreen, CRGB::LawnGreen, CRGB::MediumAquamarine, CRGB::ForestGreen
+};
+
+const TProgmemRGBPalette16 RainbowColors_p = {
+  0xFF0000, 0xD52A00, 0xAB5500, 0xAB7F00,
+  0xABAB00, 0x56D500, 0x00FF00, 0x00D52A,
+  0x00AB55, 0x0056AA, 0x0000FF, 0x2A00D5,
+  0x5500AB, 0x7F0081, 0xAB0055, 0xD5002B
+};
+
+const TProgmemRGBPalette16 PartyColors_p = {
+  0x5500AB, 0x84007C, 0xB5004B, 0xE5001B,
+  0xE81700, 0xB84700, 0xAB7700, 0xABAB00,
+  0xAB5500, 0xDD2200, 0xF2000E, 0xC2003E,
+  0x8F0071, 0x5F00A1, 0x2F00D0, 0x0007F9
+};
+
+const TProgmemRGBPalette16 HeatColors_p = {
+  0x000000, 0x330000, 0x660000, 0x990000,
+  0xCC0000, 0xFF0000, 0xFF3300, 0xFF6600,
+  0xFF9900, 0xFFCC00, 0xFFFF00, 0xFFFF33,
+  0xFFFF66, 0xFFFF99, 0xFFFFCC, 0xFFFFFF
+};
+
+// Controller
+
+typedef enum { RGB = 0012, RBG = 0021, GRB = 0102, GBR = 0120, BRG = 0201, BGR = 0210 } EOrder;
+
+template <uint8_t DATA_PIN, EOrder RGB_ORDER> class WS2811 {};
+template <uint8_t DATA_PIN, EOrder RGB_ORDER> class WS2812 {};
+template <uint8_t DATA_PIN, EOrder RGB_ORDER> class WS2812B {};
+template <uint8_t DATA_PIN, EOrder RGB_ORDER> class NEOPIXEL {};
+
+void hostShow(const CRGB *data, int numLeds, uint8_t brightness);
+
+class CFastLED {
+  public:
+    template <template <uint8_t DATA_PIN, EOrder RGB_ORDER> class CHIPSET, uint8_t DATA_PIN, EOrder RGB_ORDER>
+    void addLeds(CRGB *data, int numLeds) {
+      leds = data;
+      count = numLeds;
+    }
+
+    void setBrightness(uint8_t scale) {
+      brightness = scale;
+    }
+
+    uint8_t getBrightness() {
+      return brightness;
+    }
+
+    void show() {
+      hostShow(leds, count, brightness);
+    }
+
+  private:
+    CRGB *leds = 0;
+    int count = 0;
+    uint8_t brightness = 255;
+};
+
+extern CFastLED FastLED;
+
+#endif
@@ -0,0 +1,74 @@
+// The sketch's audio input on the audio thread of the host runtime
+//
+// The input (AUDIOINPUT, audioMAX9814.h unless set) is compiled into a
+// namespace of its own, so its globals are private to the audio thread
+// and the render thread's spectrumValue[] and friends are separate ones
+// (see audioFeed.h). Its clock is private too: micros() in the namespace
+// reads analysisMicros, which analysisStep() advances, and analogRead()
+// goes to the host's hostAnalogRead().
+
+#include "Arduino.h"
+#include "live.h"
+
+#ifndef AUDIOINPUT
+#define AUDIOINPUT "audioMAX9814.h"
+#endif
+
+namespace analysis {
+
+unsigned long analysisMicros = 0;
+
+inline unsigned long micros() {
+  return analysisMicros;
+}
+
+inline unsigned long millis() {
+  return analysisMicros / 1000;
+}
+
+inline void delayMicroseconds(unsigned int us) {
+  analysisMicros += us;
+}
+
+// audioMAX9814.h drops the samples around a show, but the audio thread
+// samples right through the other threads' shows
+byte showCount = 0;
+
+#include AUDIOINPUT // found through -I..
+
+}
+
+const unsigned long analysisStepMicros = AUDIODELAY * 1000UL;
+unsigned long *const analysisClock = &analysis::analysisMicros;
+
+void analysisSetup() {
+  analysis::audioSetup();
+}
+
+// The gain as a factor: the inputs keep it as a float, the fixed point
+// audio.h as Q4.12
+float gainFactor(float gain) {
+  return gain;
+}
+
+float gainFactor(unsigned int gain) {
+  return gain / 4096.0;
+}
+
+// Run doAnalogs() at the given time, like audioTask() would
+bool analysisStep(unsigned long micros, audioFeatures &features) {
+  using namespace analysis;
+
+  analysisMicros = micros;
+  doAnalogs();
+  if (!spectrumUpdated) return false;
+  spectrumUpdated = false;
+
+  for (byte i = 0; i < 7; i++) {
+    features.spectrumValue[i] = spectrumValue[i];
+    features.spectrumDecay[i] = spectrumDecay[i];
+    features.spectrumPeaks[i] = spectrumPeaks[i];
+  }
+  features.gainAGC = gainFactor(gainAGC);
+  return true;
+}
@@ -0,0 +1,47 @@
+// Host only audio input that takes its spectra from the audio thread
+//
+// The render thread of live.cpp is built with AUDIOINPUT='"audioFeed.h"'.
+// The analysis itself runs on the audio thread (analysis.cpp), which
+// publishes every spectrum through audioBuffer; doAnalogs() takes the
+// newest one, if there is one, into the usual globals. Spectra that
+// arrive faster than audioTask() runs are skipped, not queued.
+
+#define AUDIOFEED
+
+#define AUDIODELAY 1
+#define ANALOGPIN 0
+
+#include "live.h"
+
+// Global variables, as in audioMAX9814.h
+unsigned int spectrumValue[7];
+boolean spectrumUpdated = false;
+float spectrumDecay[7] = {0};
+float spectrumPeaks[7] = {0};
+float gainAGC = 0.0;
+
+unsigned long audioFeedTaken = 0;      // spectra taken
+unsigned long audioFeedSkipped = 0;    // published but replaced before they were taken
+unsigned long audioFeedSequence = 0;   // of the last one taken
+uint64_t audioFeedNanos = 0;           // when the last one taken was published
+
+void audioSetup() {
+}
+
+void doAnalogs() {
+  if (!audioBuffer.update()) return;
+  const audioFeatures &features = audioBuffer.front();
+
+  for (byte i = 0; i < 7; i++) {
+    spectrumValue[i] = features.spectrumValue[i];
+    spectrumDecay[i] = features.spectrumDecay[i];
+    spectrumPeaks[i] = features.spectrumPeaks[i];
+  }
+  gainAGC = features.gainAGC;
+  spectrumUpdated = true;
+
+  if (audioFeedTaken > 0) audioFeedSkipped += features.sequence - audioFeedSequence - 1;
+  audioFeedTaken++;
+  audioFeedSequence = features.sequence;
+  audioFeedNanos = features.nanos;
+}
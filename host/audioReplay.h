@@ -0,0 +1,83 @@
+// Host only audio input that plays back a capture made with AUDIOCAPTURE
+//
+// Select it with AUDIOINPUT='"audioReplay.h"' (see the replay targets in
+// the Makefile). The simulator opens the capture given with -r. Records are
+// loaded when the simulated clock reaches their time, counted from the
+// first record, so a replay sees the same spectra at the same moments on
+// every run. beat.h analyzes the replayed spectrumValue itself; the beat
+// flags of the capture are kept in recordedFlags for comparison.
+// The run ends with the capture.
+
+#define AUDIOREPLAY
+
+#define AUDIODELAY 1
+#define ANALOGPIN 0
+
+// Global variables, as in audioMAX9814.h
+unsigned int spectrumValue[7];
+boolean spectrumUpdated = false;
+float spectrumDecay[7] = {0};
+float spectrumPeaks[7] = {0};
+float gainAGC = 0.0;
+
+byte recordedFlags = 0;            // AUDIORECORD_ flags of the last record
+byte recordedBeatsPerMinute = 0;
+
+FILE *audioReplayFile = NULL;       // set by the simulator
+boolean audioReplayEnded = false;
+unsigned long audioReplayRecords = 0;
+
+byte replayRecord[54];              // next record, AUDIORECORDSIZE
+boolean replayLoaded = false;
+unsigned long replayStartMicros;    // micros() at audioSetup()
+unsigned long replayFirstMicros;    // time stamp of the first record
+
+boolean audioRecordValid(const byte *record);
+unsigned long audioRecordMicros(const byte *record);
+void unpackAudioRecord(const byte *record);
+
+// Read the next good record, skipping anything that is not one
+boolean readReplayRecord() {
+  const size_t rest = sizeof(replayRecord) - 2;
+  while (true) {
+    int c = fgetc(audioReplayFile);
+    if (c == EOF) return false;
+    if (c != 0xA5) continue;
+    c = fgetc(audioReplayFile);
+    if (c != 0x5A) {
+      if (c == EOF) return false;
+      ungetc(c, audioReplayFile);
+      continue;
+    }
+
+    replayRecord[0] = 0xA5;
+    replayRecord[1] = 0x5A;
+    if (fread(replayRecord + 2, 1, rest, audioReplayFile) != rest) return false;
+    if (audioRecordValid(replayRecord)) return true;
+    fseek(audioReplayFile, -(long)rest, SEEK_CUR); // a sync pair may be inside
+  }
+}
+
+void audioSetup() {
+  replayStartMicros = micros();
+  replayLoaded = false;
+  if (!audioReplayFile || !readReplayRecord()) {
+    audioReplayEnded = true;
+    return;
+  }
+  replayFirstMicros = audioRecordMicros(replayRecord);
+  replayLoaded = true;
+}
+
+// Load the next record once it is due, at most one per call like a real input
+void doAnalogs() {
+  if (!replayLoaded) return;
+  if (micros() - replayStartMicros < audioRecordMicros(replayRecord) - replayFirstMicros) return;
+
+  unpackAudioRecord(replayRecord);
+  spectrumUpdated = true;
+  audioReplayRecords++;
+
+  replayLoaded = readReplayRecord();
+  if (!replayLoaded) audioReplayEnded = true;
+}
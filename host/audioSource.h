@@ -0,0 +1,289 @@
+// Audio input of the host programs (sim.cpp, live.cpp)
+//
+// An audioSource streams mono samples, full scale +-1, in blocks: the
+// synthetic testSignal, or pcmSource with PCM from a WAV file or stdin.
+// In front of it an emulation of the board answers the sketch's pin
+// reads:
+//
+//   MAX9814  analogRead() is the amplifier output at the ADC, 256 counts
+//            of bias plus 256 per full scale, the next source sample for
+//            every ADCSAMPLEMICROS conversion. Point sampled with linear
+//            interpolation, the ADC has no anti-alias filter either.
+//   MSGEQ7   analogRead() is the level of the band the strobe pin
+//            selected, from seven band-pass filters with peak detectors
+//            run over the source up to the reader's clock. The first
+//            pulse on the reset pin, which only audio.h drives, switches
+//            to this emulation.
+//
+// Samples are consumed as the simulated clock asks for them, so a file
+// plays at its own speed in simulated time however fast the host runs.
+// audioInputEnded is set when the file or stdin runs out.
+
+#include <atomic>
+#include <errno.h>
+
+#define ADCSAMPLEMICROS 104 // free running conversion time, as in audioMAX9814.h
+#define ADCBIAS 256         // MAX9814 1.25V output bias
+#define ADCFULLSCALE 256
+#define MSGEQ7STROBEPIN 8   // as in audio.h
+#define MSGEQ7RESETPIN 7
+#define MSGEQ7FLOOR 80      // output with no signal, about 0.4V
+#define MSGEQ7FULLSCALE 860
+#define MSGEQ7RELEASEMS 40  // peak detector decay time constant
+#define MSGEQ7Q 1.4
+#define AUDIOBLOCK 1024     // samples read from a source at a time
+
+class audioSource {
+  public:
+    double rate = 1000000.0 / ADCSAMPLEMICROS;
+
+    virtual ~audioSource() {}
+
+    // Fill up to count samples, fewer only at the end of the input
+    virtual size_t read(float *samples, size_t count) = 0;
+};
+
+// A decaying 60Hz kick on every beat, a noise hat on the off beats and a
+// steady 1kHz tone, at the ADC rate
+class testSignal : public audioSource {
+  public:
+    float beatsPerMinute = 120;
+
+    size_t read(float *samples, size_t count) {
+      const float sampleRate = 1000000.0 / ADCSAMPLEMICROS;
+      for (size_t i = 0; i < count; i++) {
+        float t = sampleCount++ / sampleRate;
+
+        noiseSeed = noiseSeed * 2053 + 13849;
+        float noise = (int)(noiseSeed >> 8) - 128;
+
+        float sample = 25.0 * sinf(2 * M_PI * 1000.0 * t);
+        if (beatsPerMinute > 0) {
+          float beat = 60.0 / beatsPerMinute;
+          float beatTime = fmodf(t, beat);
+          float hatTime = fmodf(t + beat / 2, beat);
+          sample += 220.0 * expf(-beatTime * 12.0) * sinf(2 * M_PI * 60.0 * t);
+          sample += 0.6 * noise * expf(-hatTime * 40.0);
+        }
+        samples[i] = sample / ADCFULLSCALE;
+      }
+      return count;
+    }
+
+  private:
+    unsigned long sampleCount = 0;
+    uint16_t noiseSeed = 1;
+};
+
+// 8 or 16 bit PCM from a WAV file, or raw signed 16 bit little endian
+// when the input does not start with a RIFF header. Channels are mixed
+// down to mono.
+class pcmSource : public audioSource {
+  public:
+    // false if the WAV header is not one we can play
+    bool open(FILE *input, double rawRate) {
+      file = input;
+      rate = rawRate;
+      unsigned char header[12];
+      size_t got = fread(header, 1, 4, file);
+      if (got < 4 || memcmp(header, "RIFF", 4)) {
+        memcpy(pending, header, got); // the first samples of a raw stream
+        pendingBytes = got;
+        return true;
+      }
+      if (fread(header + 4, 1, 8, file) != 8 || memcmp(header + 8, "WAVE", 4)) return false;
+
+      // chunks up to the samples, the format must come first
+      unsigned char chunk[8];
+      while (fread(chunk, 1, 8, file) == 8) {
+        uint32_t length = chunk[4] | chunk[5] << 8 | chunk[6] << 16 | (uint32_t)chunk[7] << 24;
+        if (!memcmp(chunk, "data", 4)) return sampleBytes != 0;
+        if (!memcmp(chunk, "fmt ", 4) && length >= 16) {
+          unsigned char format[16];
+          if (fread(format, 1, 16, file) != 16) return false;
+          uint16_t tag = format[0] | format[1] << 8;
+          channels = format[2] | format[3] << 8;
+          rate = format[4] | format[5] << 8 | format[6] << 16 | (uint32_t)format[7] << 24;
+          uint16_t bits = format[14] | format[15] << 8;
+          if ((tag != 1 && tag != 0xFFFE) || (bits != 8 && bits != 16) || channels == 0) return false;
+          sampleBytes = bits / 8;
+          length -= 16;
+        }
+        for (length += length & 1; length > 0; length--) { // rest of the chunk and its pad byte, stdin cannot seek
+          if (fgetc(file) == EOF) return false;
+        }
+      }
+      return false;
+    }
+
+    size_t read(float *samples, size_t count) {
+      size_t frameBytes = channels * sampleBytes;
+      unsigned char block[AUDIOBLOCK * 8];
+      if (count * frameBytes > sizeof(block)) count = sizeof(block) / frameBytes;
+
+      size_t bytes = pendingBytes;
+      memcpy(block, pending, pendingBytes);
+      pendingBytes = 0;
+      bytes += fread(block + bytes, 1, count * frameBytes - bytes, file);
+
+      size_t frames = bytes / frameBytes;
+      const unsigned char *in = block;
+      for (size_t i = 0; i < frames; i++) {
+        float sum = 0;
+        for (unsigned c = 0; c < channels; c++) {
+          if (sampleBytes == 1) sum += (*in - 128) / 128.0f;
+          else sum += (int16_t)(in[0] | in[1] << 8) / 32768.0f;
+          in += sampleBytes;
+        }
+        samples[i] = sum / channels;
+      }
+      return frames;
+    }
+
+  private:
+    FILE *file = NULL;
+    unsigned channels = 1;
+    unsigned sampleBytes = 2;
+    unsigned char pending[4];
+    size_t pendingBytes = 0;
+};
+
+testSignal testInput;
+audioSource *audioInput = &testInput;
+const unsigned long *audioInputClock = &hostMicros; // micros() of the code reading the input
+std::atomic<bool> audioInputEnded{false};
+
+float audioBlock[AUDIOBLOCK];
+size_t audioBlockHead = 0;
+size_t audioBlockCount = 0;
+
+// Next source sample, silence once the input ran out
+float nextAudioSample() {
+  if (audioBlockHead == audioBlockCount) {
+    audioBlockHead = 0;
+    audioBlockCount = audioInput->read(audioBlock, AUDIOBLOCK);
+    if (audioBlockCount == 0) {
+      audioInputEnded = true;
+      return 0;
+    }
+  }
+  return audioBlock[audioBlockHead++];
+}
+
+// MAX9814: one conversion, the source resampled to the ADC rate
+unsigned long adcReads = 0;
+unsigned long long adcSourceSamples = 0; // taken from the source so far
+float adcPrevious = 0;
+float adcNext = 0;
+
+int max9814Read() {
+  float sample;
+  if (audioInput->rate == 1000000.0 / ADCSAMPLEMICROS) {
+    sample = nextAudioSample(); // sample for sample
+  } else {
+    double position = (double)adcReads * ADCSAMPLEMICROS * audioInput->rate / 1000000.0;
+    while (adcSourceSamples < (unsigned long long)position + 2) { // up to the sample after position
+      adcPrevious = adcNext;
+      adcNext = nextAudioSample();
+      adcSourceSamples++;
+    }
+    float fraction = position - (adcSourceSamples - 2);
+    sample = adcPrevious + (adcNext - adcPrevious) * fraction;
+  }
+  adcReads++;
+
+  int value = ADCBIAS + (int)(sample * ADCFULLSCALE);
+  return constrain(value, 0, 1023);
+}
+
+// MSGEQ7: band-pass biquads at the chip's centre frequencies, each with a
+// peak detector
+struct msgeq7Band {
+  float b0, b2, a1, a2; // b1 is 0 for a band-pass
+  float x1, x2, y1, y2;
+  float level;
+};
+
+const float msgeq7Centres[7] = {63, 160, 400, 1000, 2500, 6250, 16000};
+msgeq7Band msgeq7Bands[7];
+float msgeq7Release;
+bool msgeq7Active = false;
+byte msgeq7Selected = 0;
+bool msgeq7Reset = false;
+bool msgeq7Strobe = true;
+unsigned long msgeq7StartMicros;
+unsigned long long msgeq7Samples = 0; // run through the filters so far
+
+void startMSGEQ7() {
+  double rate = audioInput->rate;
+  for (byte i = 0; i < 7; i++) {
+    msgeq7Band &band = msgeq7Bands[i];
+    memset(&band, 0, sizeof(band));
+    if (msgeq7Centres[i] >= rate / 2) continue; // above Nyquist, stays at the floor
+    double w = 2 * M_PI * msgeq7Centres[i] / rate;
+    double alpha = sin(w) / (2 * MSGEQ7Q);
+    double a0 = 1 + alpha;
+    band.b0 = alpha / a0;
+    band.b2 = -alpha / a0;
+    band.a1 = -2 * cos(w) / a0;
+    band.a2 = (1 - alpha) / a0;
+  }
+  msgeq7Release = exp(-1000.0 / (rate * MSGEQ7RELEASEMS));
+  msgeq7StartMicros = *audioInputClock;
+  msgeq7Active = true;
+}
+
+// Run the filters over the source up to the reader's clock
+void runMSGEQ7() {
+  unsigned long long due = (unsigned long long)(*audioInputClock - msgeq7StartMicros) * audioInput->rate / 1000000;
+  for (; msgeq7Samples < due; msgeq7Samples++) {
+    float x = nextAudioSample();
+    for (byte i = 0; i < 7; i++) {
+      msgeq7Band &band = msgeq7Bands[i];
+      float y = band.b0 * x + band.b2 * band.x2 - band.a1 * band.y1 - band.a2 * band.y2;
+      band.x2 = band.x1;
+      band.x1 = x;
+      band.y2 = band.y1;
+      band.y1 = y;
+      band.level = fmaxf(fabsf(y), band.level * msgeq7Release);
+    }
+  }
+}
+
+int msgeq7Read() {
+  runMSGEQ7();
+  int value = MSGEQ7FLOOR + (int)(msgeq7Bands[msgeq7Selected].level * MSGEQ7FULLSCALE);
+  return constrain(value, 0, 1023);
+}
+
+int hostAnalogRead(uint8_t pin) {
+  return msgeq7Active ? msgeq7Read() : max9814Read();
+}
+
+// The reset pin restarts the band sequence, every falling strobe edge
+// selects the next band
+void hostDigitalWrite(uint8_t pin, uint8_t value) {
+  if (pin == MSGEQ7RESETPIN) {
+    if (value == HIGH && !msgeq7Active) startMSGEQ7();
+    if (value == HIGH) msgeq7Reset = true;
+  } else if (pin == MSGEQ7STROBEPIN) {
+    if (value == LOW && msgeq7Strobe) {
+      msgeq7Selected = msgeq7Reset ? 0 : (msgeq7Selected + 1) % 7;
+      msgeq7Reset = false;
+    }
+    msgeq7Strobe = value == HIGH;
+  }
+}
+
+// Open -i: a WAV file, or raw 16 bit PCM at rawRate; "-" is stdin
+bool openAudioInput(const char *path, double rawRate) {
+  static pcmSource pcmInput;
+  FILE *file = strcmp(path, "-") ? fopen(path, "rb") : stdin;
+  if (!file) return false;
+  if (!pcmInput.open(file, rawRate)) {
+    errno = EINVAL;
+    return false;
+  }
+  audioInput = &pcmInput;
+  return true;
+}
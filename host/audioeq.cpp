@@ -0,0 +1,182 @@
+// The float and the fixed point MSGEQ7 analysis of audio.h side by side
+//
+// Both builds of audio.h are compiled into namespaces of their own, as in
+// analysis.cpp, and every AUDIODELAY both run doAnalogs() on the same
+// seven band reads, taken once from the MSGEQ7 emulation in audioSource.h.
+// The run ends with AUDIOEQQUIETMILLIS of silence, which drives the gain
+// to its upper limit, and AUDIOEQLOUDMILLIS of every band at full scale,
+// the largest values the arithmetic ever sees. At the end it prints the
+// largest difference of each output and how long one doAnalogs() took on
+// this host, and fails if a level ever differed by more than
+// AUDIOEQTOLERANCE counts.
+//
+// audio.h relies on int being 16 bits, as on the AVR, so both builds are
+// compiled with int made short: its int and unsigned int variables wrap
+// where the device's would. Products of two of them are still computed
+// in 32 bits here; the static_asserts below check that none of those in
+// audio.h can exceed 16 bits.
+//
+//   audioeq [-d ms] [-b bpm] [-i audio] [-R rate]
+//
+//   -d  simulated run time in milliseconds (default 60000)
+//   -b  tempo of the synthetic audio signal (default 120, 0 for no beat)
+//   -i  audio input instead of the synthetic signal, as for sim; the run
+//       ends with it unless -d is given
+//   -R  sample rate of raw PCM input (default 44100)
+
+#include "Arduino.h"
+
+#include <chrono>
+#include <unistd.h>
+
+#define AUDIOEQTOLERANCE 2
+#define AUDIOEQQUIETMILLIS 30000
+#define AUDIOEQLOUDMILLIS 5000
+#define AUDIOEQFULLSCALE 1023
+
+unsigned long hostMicros = 0;
+
+#include "audioSource.h"
+
+int bandReads[7]; // this update's reads, the same for both
+
+// Pin access of one audio.h build: the reset pulse starts the band
+// sequence over, every analogRead() takes the next band
+#define AUDIOEQPINS \
+  byte nextBand = 0; \
+  inline void pinMode(uint8_t pin, uint8_t mode) {} \
+  inline void delayMicroseconds(unsigned int us) {} \
+  inline void digitalWrite(uint8_t pin, uint8_t value) { \
+    if (pin == MSGEQ7RESETPIN && value == HIGH) nextBand = 0; \
+  } \
+  inline int analogRead(uint8_t pin) { \
+    return bandReads[nextBand++ % 7]; \
+  }
+
+#define int short // 16 bits, as on the AVR
+
+namespace floatAudio {
+AUDIOEQPINS
+#define FLOATAUDIO
+#include "../audio.h"
+}
+
+#undef FLOATAUDIO
+#undef FIXEDPOINTAUDIO
+#undef NOISEFLOOR
+
+namespace fixedAudio {
+AUDIOEQPINS
+#include "../audio.h"
+}
+
+#undef int
+
+static_assert(sizeof(fixedAudio::spectrumValue[0]) == 2, "audio.h built with a 32 bit int");
+
+// The band correction product, the AGC sum of seven bands and the level
+// after the gain, at full scale
+static_assert((AUDIOEQFULLSCALE - NOISEFLOOR) * 13 <= 0xFFFF, "band correction overflows 16 bits");
+static_assert(7 * ((AUDIOEQFULLSCALE - NOISEFLOOR) * 13 / 10) <= 0x7FFF, "analogsum overflows a 16 bit int");
+static_assert((AUDIOEQFULLSCALE - NOISEFLOOR) * 13 / 10 * GAINUPPERLIMIT <= 0xFFFF, "gained level overflows 16 bits");
+
+// Largest difference seen so far of one output
+struct audioDifference {
+  const char *name;
+  float largest;
+  bool level; // held to AUDIOEQTOLERANCE
+
+  void add(float a, float b) {
+    float difference = fabsf(a - b);
+    if (difference > largest) largest = difference;
+  }
+};
+
+int main(int argc, char **argv) {
+  unsigned long runMillis = 60000;
+  bool runSet = false;
+  const char *audioPath = NULL;
+  double rawRate = 44100;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "d:b:i:R:")) != -1) {
+    switch (opt) {
+      case 'd':
+        runMillis = strtoul(optarg, NULL, 10);
+        runSet = true;
+        break;
+      case 'b': testInput.beatsPerMinute = atof(optarg); break;
+      case 'i': audioPath = optarg; break;
+      case 'R': rawRate = atof(optarg); break;
+      default:
+        fprintf(stderr, "usage: %s [-d ms] [-b bpm] [-i audio] [-R rate]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  if (audioPath) {
+    if (!openAudioInput(audioPath, rawRate)) {
+      perror(audioPath);
+      return 1;
+    }
+    if (!runSet) runMillis = (unsigned long)-1 / 1000; // until the input ends
+  }
+
+  audioDifference differences[] = {
+    {"spectrumValue", 0, true},
+    {"spectrumDecay", 0, true},
+    {"spectrumPeaks", 0, true},
+    {"gainAGC", 0, false},
+  };
+  std::chrono::steady_clock::duration floatTime{0}, fixedTime{0};
+
+  floatAudio::audioSetup();
+  fixedAudio::audioSetup();
+  startMSGEQ7();
+
+  unsigned long updates = 0;
+  unsigned long signalMicros = 0; // where the signal ended and the silence began
+  unsigned long endMicros = (unsigned long)-1;
+  while (hostMicros < endMicros) {
+    if (endMicros == (unsigned long)-1 && (hostMicros >= runMillis * 1000 || audioInputEnded)) {
+      signalMicros = hostMicros;
+      endMicros = hostMicros + (AUDIOEQQUIETMILLIS + AUDIOEQLOUDMILLIS) * 1000UL;
+    }
+    for (byte i = 0; i < 7; i++) {
+      if (endMicros == (unsigned long)-1) {
+        msgeq7Selected = i;
+        bandReads[i] = msgeq7Read();
+      } else {
+        bandReads[i] = hostMicros - signalMicros < AUDIOEQQUIETMILLIS * 1000UL ? 0 : AUDIOEQFULLSCALE;
+      }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    floatAudio::doAnalogs();
+    auto middle = std::chrono::steady_clock::now();
+    fixedAudio::doAnalogs();
+    fixedTime += std::chrono::steady_clock::now() - middle;
+    floatTime += middle - start;
+    updates++;
+
+    for (byte i = 0; i < 7; i++) {
+      differences[0].add(floatAudio::spectrumValue[i], fixedAudio::spectrumValue[i]);
+      differences[1].add(floatAudio::spectrumDecay[i], fixedAudio::spectrumDecay[i]);
+      differences[2].add(floatAudio::spectrumPeaks[i], fixedAudio::spectrumPeaks[i]);
+    }
+    differences[3].add(floatAudio::gainAGC, fixedAudio::gainAGC / 4096.0);
+    hostMicros += AUDIODELAY * 1000UL;
+  }
+
+  bool failed = false;
+  printf("%lu updates, %.2f s\n", updates, hostMicros / 1e6);
+  for (const audioDifference &difference : differences) {
+    bool over = difference.level && difference.largest > AUDIOEQTOLERANCE;
+    printf("%-14s largest difference %.3f%s\n", difference.name, difference.largest, over ? "  FAIL" : "");
+    failed |= over;
+  }
+  printf("doAnalogs() on this host: float %.0f ns, fixed point %.0f ns\n",
+         std::chrono::duration<double, std::nano>(floatTime).count() / updates,
+         std::chrono::duration<double, std::nano>(fixedTime).count() / updates);
+  return failed ? 1 : 0;
+}
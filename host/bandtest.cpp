@@ -0,0 +1,56 @@
+// Band response of the MAX9814 input's FFT, one test tone per band
+//
+// audioMAX9814.h is fed a pure tone in the middle of each band's bins for
+// TONEMILLIS, then the seven levels of the last frame are printed. Fails
+// if the tone's band is not the loudest, or if a band that is not its
+// neighbour gets more than an eighth of it (the Hann window spreads a
+// tone over about three bins, so the next band over may see some).
+//
+//   bandtest
+
+#include "Arduino.h"
+
+#define TONEMILLIS 2000
+
+unsigned long hostMicros = 0;
+byte showCount = 0; // nothing is shown, so there are no gaps
+
+double toneHz = 0;
+unsigned long toneSamples = 0;
+
+#include "../audioMAX9814.h"
+
+// Every read is the next conversion of the free running ADC
+int hostAnalogRead(uint8_t pin) {
+  double seconds = toneSamples++ * SAMPLEMICROS / 1e6;
+  return 512 + (int)(300 * sin(2 * M_PI * toneHz * seconds));
+}
+
+int main() {
+  audioSetup();
+
+  bool failed = false;
+  for (byte band = 0; band < 7; band++) {
+    byte firstBin = bandBins[band];
+    byte lastBin = bandBins[band + 1];
+    toneHz = (firstBin + lastBin - 1) / 2.0 * 1e6 / SAMPLEMICROS / FFTSIZE;
+
+    for (unsigned int ms = 0; ms < TONEMILLIS; ms++) {
+      hostMicros += 1000;
+      doAnalogs();
+    }
+
+    unsigned int level = spectrumValue[band];
+    bool ok = true;
+    printf("band %d, %4.0f Hz:", band, toneHz);
+    for (byte i = 0; i < 7; i++) {
+      printf(" %4u", spectrumValue[i]);
+      if (i == band) continue;
+      if (spectrumValue[i] >= level) ok = false;
+      if (abs(i - band) > 1 && spectrumValue[i] > level / 8) ok = false;
+    }
+    printf("%s\n", ok ? "" : "  FAIL");
+    failed |= !ok;
+  }
+  return failed ? 1 : 0;
+}
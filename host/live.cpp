@@ -0,0 +1,370 @@
+// Multi-threaded host runtime of the RGB Shades sketch
+//
+// Runs the sketch on three kinds of threads that share nothing but triple
+// buffers (tripleBuffer.h):
+//
+//   audio   the audio input's analysis on its own copy of its state
+//           (analysis.cpp), publishing every spectrum to audioBuffer
+//   render  setup() and loop(), built with AUDIOINPUT='"audioFeed.h"' so
+//           doAnalogs() takes the newest spectrum; FastLED.show() copies
+//           the strip to frameBuffer
+//   output  takes the newest frame and encodes it for its share of the
+//           virtual panels, scaled by the frame's brightness, in the
+//           strip's GRB order; with -w the panels are split over that
+//           many output threads, each with a frame buffer of its own
+//
+// The render thread never waits for the strip, and none of the threads
+// ever waits for another: a stage that falls behind skips to the newest
+// spectrum or frame. The audio thread follows the render thread's clock,
+// so the sketch and its input see the same time; with -x the render
+// thread waits for the audio thread to catch up with its clock before
+// every loop() pass, or the audio would fall behind and skip spectra.
+// That also makes a fast run take the same spectra, and render the same
+// frames, every time.
+//
+//   live [-d ms] [-e effect] [-a] [-m] [-l us] [-b bpm] [-i audio] [-R rate] [-v panels] [-w threads] [-x] [-o frames.rgb] [-H] [-t]
+//
+//   -d  run time in milliseconds (default 10000)
+//   -e  start on this effect index
+//   -a  use the audio effect list
+//   -m  manual mode, do not auto cycle effects
+//   -l  simulated overhead per loop() pass in microseconds (default 100)
+//   -b  tempo of the synthetic audio signal (default 120, 0 for no beat)
+//   -i  audio input instead of the synthetic signal: a WAV file, or raw
+//       signed 16 bit mono PCM, "-" for stdin (see audioSource.h); the run
+//       ends with it unless -d is given
+//   -R  sample rate of raw PCM input (default 44100)
+//   -v  number of virtual panels the output threads feed (default 1)
+//   -w  number of output threads, up to MAXOUTPUTS (default 1)
+//   -x  run as fast as possible on the simulated clock instead of in real
+//       time; the output thread then skips the strip time per frame
+//   -o  append every frame sent to this file as raw RGB, like sim -o
+//   -H  print a hash of every rendered frame to stdout at the end, like
+//       sim -H; repeatable with -x, in real time the spectra a frame sees
+//       depend on the threads' timing
+//   -t  print the results as one tab separated line to stdout:
+//       layout mode panels threads seconds rendered sent skipped fps
+//       simfps spectra audioskipped latencyavg latencyp99 latencymax
+//
+// Latency is audio to light, in microseconds of wall time: from the
+// moment a spectrum was published to the moment the first frame rendered
+// after it was taken was sent to the panels. With several output threads
+// sent and fps are those of the slowest, skipped that of the one that
+// skipped most, and the latencies those of all of them. fps is frames sent
+// per second of wall time, simfps per simulated second; in real time the
+// two are the same, with -x simfps is the frame rate the sketch would
+// have. See the live-bench target in the Makefile.
+
+#include "Arduino.h"
+#include "FastLED.h"
+#include "EEPROM.h"
+#include "live.h"
+
+#include <unistd.h>
+#include <time.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+unsigned long hostMicros = 0;
+uint16_t rand16seed = 1337;
+HardwareSerial Serial;
+CFastLED FastLED;
+EEPROMClass EEPROM;
+
+TripleBuffer<audioFeatures> audioBuffer;
+
+uint64_t liveNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#include "../RGBShadesAudioOriginal.ino"
+
+#define WS2811MICROS 30 // time to clock out one pixel at 800kHz
+#define LATCHMICROS 50
+#define MAXOUTPUTS 16
+
+// A shown frame, in strip order
+struct liveFrame {
+  CRGB strip[LAST_VISIBLE_LED + 1];
+  uint8_t brightness;
+  unsigned long sequence; // shows since the start
+  uint64_t audioNanos;    // publish time of the spectrum the render thread had last taken
+};
+
+// One output thread: its frame buffer, its panels and what it sent
+struct liveOutput {
+  TripleBuffer<liveFrame> frameBuffer;
+  int firstPanel;
+  int panels;
+  unsigned long sentFrames = 0;
+  unsigned long skippedFrames = 0;
+  std::vector<uint32_t> latencies; // microseconds, one per frame with a newer spectrum
+};
+
+liveOutput outputs[MAXOUTPUTS];
+int outputThreads = 1;
+unsigned long renderedFrames = 0;
+uint32_t renderedFramesHash = 2166136261u; // FNV-1a over every rendered pixel and brightness
+
+std::atomic<unsigned long> liveClock{0};  // render thread's micros(), for the audio thread
+std::atomic<unsigned long> audioClock{0}; // how far the audio thread got
+std::atomic<bool> running{true};
+bool fastRun = false;
+
+// Render thread: hand the frame to every output thread
+void hostShow(const CRGB *data, int numLeds, uint8_t brightness) {
+  renderedFrames++;
+  renderedFramesHash = (renderedFramesHash ^ brightness) * 16777619u;
+  for (byte y = 0; y < kMatrixHeight; y++) {
+    for (byte x = 0; x < kMatrixWidth; x++) {
+      const CRGB &pixel = leds[XY(x, y)];
+      for (byte i = 0; i < 3; i++) renderedFramesHash = (renderedFramesHash ^ pixel.raw[i]) * 16777619u;
+    }
+  }
+  for (int i = 0; i < outputThreads; i++) {
+    liveFrame &frame = outputs[i].frameBuffer.back();
+    memcpy(frame.strip, data, sizeof(frame.strip));
+    frame.brightness = brightness;
+    frame.sequence = renderedFrames;
+    frame.audioNanos = audioFeedNanos;
+    outputs[i].frameBuffer.publish();
+  }
+}
+
+// Buttons are never pressed
+int hostDigitalRead(uint8_t pin) {
+  return HIGH;
+}
+
+#include "audioSource.h"
+
+// Serial output goes to stdout, there is no serial input
+void hostSerialBegin(unsigned long baud) {
+}
+
+int hostSerialRead() {
+  return -1;
+}
+
+void hostSerialWrite(const uint8_t *data, size_t length) {
+  fwrite(data, 1, length, stdout);
+}
+
+// Audio thread: run the analysis up to the render thread's clock
+unsigned long publishedSpectra = 0;
+
+void audioThread() {
+  analysisSetup();
+  unsigned long analysisMicros = 0;
+
+  while (running.load(std::memory_order_relaxed)) {
+    unsigned long target = liveClock.load(std::memory_order_acquire);
+    if (target - analysisMicros < analysisStepMicros) {
+      if (fastRun) std::this_thread::yield();
+      else usleep(analysisStepMicros / 4);
+      continue;
+    }
+    analysisMicros += analysisStepMicros;
+
+    audioFeatures &features = audioBuffer.back();
+    if (analysisStep(analysisMicros, features)) {
+      features.sequence = ++publishedSpectra;
+      features.nanos = liveNanos();
+      audioBuffer.publish();
+    }
+    audioClock.store(analysisMicros, std::memory_order_release);
+  }
+}
+
+// Output threads: send the newest frame to their virtual panels, the
+// thread with panel 0 also writes it to the frame file
+int virtualPanels = 1;
+FILE *frameFile = NULL;
+
+void sendFrame(const liveOutput &output, const liveFrame &frame, std::vector<uint8_t> &wire) {
+  const int stripLeds = LAST_VISIBLE_LED + 1;
+  const int stripBytes = stripLeds * 3;
+  for (int panel = 0; panel < output.panels; panel++) {
+    uint8_t *out = &wire[panel * stripBytes];
+    for (int i = 0; i < stripLeds; i++) {
+      *out++ = scale8(frame.strip[i].g, frame.brightness);
+      *out++ = scale8(frame.strip[i].r, frame.brightness);
+      *out++ = scale8(frame.strip[i].b, frame.brightness);
+    }
+  }
+
+  if (output.firstPanel != 0 || !frameFile) return;
+  for (byte y = 0; y < kMatrixHeight; y++) {
+    for (byte x = 0; x < kMatrixWidth; x++) {
+      ledindex_t i = XY(x, y);
+      CRGB pixel = i <= LAST_VISIBLE_LED ? frame.strip[i] : CRGB(CRGB::Black);
+      fwrite(pixel.raw, 1, 3, frameFile);
+    }
+  }
+}
+
+void outputThread(liveOutput &output) {
+  std::vector<uint8_t> wire((size_t)output.panels * (LAST_VISIBLE_LED + 1) * 3);
+  unsigned long lastSequence = 0;
+  uint64_t lastAudioNanos = 0;
+
+  while (true) {
+    bool stopping = !running.load(std::memory_order_acquire);
+    if (!output.frameBuffer.update()) {
+      if (stopping) break;
+      if (fastRun) std::this_thread::yield();
+      else usleep(100);
+      continue;
+    }
+
+    const liveFrame &frame = output.frameBuffer.front();
+    sendFrame(output, frame, wire);
+    if (frame.audioNanos != lastAudioNanos) output.latencies.push_back((liveNanos() - frame.audioNanos) / 1000);
+    lastAudioNanos = frame.audioNanos;
+    output.sentFrames++;
+    output.skippedFrames += frame.sequence - lastSequence - 1;
+    lastSequence = frame.sequence;
+
+    // the panels clock out in parallel, each takes one strip's time
+    if (!fastRun) usleep((LAST_VISIBLE_LED + 1) * WS2811MICROS + LATCHMICROS);
+  }
+}
+
+unsigned long wallMicros(uint64_t startNanos) {
+  return (liveNanos() - startNanos) / 1000;
+}
+
+int main(int argc, char **argv) {
+  unsigned long runMillis = 10000;
+  bool runSet = false;
+  const char *audioPath = NULL;
+  double rawRate = 44100;
+  unsigned long loopMicros = 100;
+  int startEffect = -1;
+  bool audioList = false;
+  bool manual = false;
+  bool printHash = false;
+  bool printTable = false;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "d:e:aml:b:i:R:v:w:xo:Ht")) != -1) {
+    switch (opt) {
+      case 'd':
+        runMillis = strtoul(optarg, NULL, 10);
+        runSet = true;
+        break;
+      case 'e': startEffect = atoi(optarg); break;
+      case 'a': audioList = true; break;
+      case 'm': manual = true; break;
+      case 'l': loopMicros = strtoul(optarg, NULL, 10); break;
+      case 'b': testInput.beatsPerMinute = atof(optarg); break;
+      case 'i': audioPath = optarg; break;
+      case 'R': rawRate = atof(optarg); break;
+      case 'v': virtualPanels = std::max(1, atoi(optarg)); break;
+      case 'w': outputThreads = std::min(std::max(1, atoi(optarg)), MAXOUTPUTS); break;
+      case 'x': fastRun = true; break;
+      case 'o':
+        frameFile = fopen(optarg, "wb");
+        if (!frameFile) {
+          perror(optarg);
+          return 1;
+        }
+        break;
+      case 'H': printHash = true; break;
+      case 't': printTable = true; break;
+      default:
+        fprintf(stderr, "usage: %s [-d ms] [-e effect] [-a] [-m] [-l us] [-b bpm] [-i audio] [-R rate] [-v panels] [-w threads] [-x] [-o frames.rgb] [-H] [-t]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  if (audioPath) {
+    if (!openAudioInput(audioPath, rawRate)) {
+      perror(audioPath);
+      return 1;
+    }
+    if (!runSet) runMillis = (unsigned long)-1 / 1000; // until the input ends
+  }
+
+  // panels split as evenly as they go, no thread without one
+  outputThreads = std::min(outputThreads, virtualPanels);
+  for (int i = 0; i < outputThreads; i++) {
+    outputs[i].firstPanel = virtualPanels * i / outputThreads;
+    outputs[i].panels = virtualPanels * (i + 1) / outputThreads - outputs[i].firstPanel;
+  }
+
+  audioInputClock = analysisClock; // the input is read on the audio thread
+  setup();
+  if (audioList) {
+    audioEnabled = true;
+    numEffects = numEffectsAudio;
+  }
+  if (manual) autoCycle = false;
+  if (startEffect >= 0) currentEffect = startEffect % numEffects;
+  selectEffect(currentEffect);
+
+  std::thread audio(audioThread);
+  std::vector<std::thread> output;
+  for (int i = 0; i < outputThreads; i++) output.emplace_back(outputThread, std::ref(outputs[i]));
+
+  // Render thread: loop() on the simulated clock, held to the wall clock
+  // unless -x
+  uint64_t startNanos = liveNanos();
+  unsigned long startMicros = hostMicros;
+  unsigned long loops = 0;
+  while (hostMicros - startMicros < runMillis * 1000 && !audioInputEnded) {
+    liveClock.store(hostMicros, std::memory_order_release);
+    if (fastRun) {
+      while (hostMicros - audioClock.load(std::memory_order_acquire) >= analysisStepMicros) std::this_thread::yield();
+    }
+    loop();
+    hostMicros += loopMicros;
+    loops++;
+    if (!fastRun) {
+      unsigned long now = startMicros + wallMicros(startNanos);
+      if (hostMicros > now) usleep(hostMicros - now);
+    }
+  }
+
+  running.store(false, std::memory_order_release);
+  audio.join();
+  for (std::thread &thread : output) thread.join();
+
+  double wallSeconds = (liveNanos() - startNanos) / 1e9;
+  double simSeconds = (hostMicros - startMicros) / 1e6;
+
+  unsigned long sentFrames = outputs[0].sentFrames;
+  unsigned long skippedFrames = outputs[0].skippedFrames;
+  std::vector<uint32_t> latencies;
+  for (int i = 0; i < outputThreads; i++) {
+    sentFrames = std::min(sentFrames, outputs[i].sentFrames);
+    skippedFrames = std::max(skippedFrames, outputs[i].skippedFrames);
+    latencies.insert(latencies.end(), outputs[i].latencies.begin(), outputs[i].latencies.end());
+  }
+  std::sort(latencies.begin(), latencies.end());
+  unsigned long latencyTotal = 0;
+  for (uint32_t latency : latencies) latencyTotal += latency;
+  unsigned long latencyAvg = latencies.empty() ? 0 : latencyTotal / latencies.size();
+  unsigned long latencyP99 = latencies.empty() ? 0 : latencies[latencies.size() * 99 / 100];
+  unsigned long latencyMax = latencies.empty() ? 0 : latencies.back();
+
+  if (printHash) printf("%08x\n", renderedFramesHash);
+  if (printTable) {
+    printf("%dx%d\t%s\t%d\t%d\t%.2f\t%lu\t%lu\t%lu\t%.1f\t%.1f\t%lu\t%lu\t%lu\t%lu\t%lu\n",
+           kMatrixWidth, kMatrixHeight, fastRun ? "fast" : "realtime", virtualPanels, outputThreads, wallSeconds,
+           renderedFrames, sentFrames, skippedFrames, sentFrames / wallSeconds, sentFrames / simSeconds,
+           publishedSpectra, audioFeedSkipped, latencyAvg, latencyP99, latencyMax);
+  }
+  if (frameFile) fclose(frameFile);
+
+  fprintf(stderr, "%dx%d, %.2f s simulated in %.3f s (%.1fx), %lu loops, %lu frames rendered, "
+          "%lu sent to %d panels by %d threads (%.1f fps, %.1f per simulated second), %lu skipped, %lu spectra (%lu skipped), "
+          "latency avg %lu us p99 %lu us max %lu us\n",
+          kMatrixWidth, kMatrixHeight, simSeconds, wallSeconds, simSeconds / wallSeconds, loops,
+          renderedFrames, sentFrames, virtualPanels, outputThreads, sentFrames / wallSeconds, sentFrames / simSeconds,
+          skippedFrames,
+          publishedSpectra, audioFeedSkipped, latencyAvg, latencyP99, latencyMax);
+  return 0;
+}
@@ -0,0 +1,29 @@
+// Shared between the threads of the multi-threaded host runtime (live.cpp)
+
+#ifndef HOST_LIVE_H
+#define HOST_LIVE_H
+
+#include <stdint.h>
+#include "tripleBuffer.h"
+
+// One spectrum of the audio thread, the fields of the audio input globals
+struct audioFeatures {
+  unsigned int spectrumValue[7];
+  float spectrumDecay[7];
+  float spectrumPeaks[7];
+  float gainAGC;          // as a factor, whatever the input keeps it as
+  unsigned long sequence; // spectra since the start
+  uint64_t nanos;         // steady clock when it was published
+};
+
+// The sketch's audio input run on the audio thread, see analysis.cpp
+extern const unsigned long analysisStepMicros; // AUDIODELAY
+extern unsigned long *const analysisClock;     // the input's micros()
+void analysisSetup();
+bool analysisStep(unsigned long micros, audioFeatures &features); // true with a new spectrum
+
+extern TripleBuffer<audioFeatures> audioBuffer;
+
+uint64_t liveNanos();
+
+#endif
@@ -0,0 +1,145 @@
+#!/bin/sh
+# Flash and SRAM budget of a sketch build, from its ELF file
+#
+#   memreport.sh sketch.elf sketchdir [builddir]
+#
+# Prints the totals against the ATmega328 limits, the biggest symbols and
+# one line per effect of both effect lists:
+#
+#   effect  lists  flash  state  frame
+#
+# flash is the size of the effect's functions (name and nameInit), state
+# its member of effectState (effects.h; all members share the space of the
+# biggest one) and frame the bigger stack frame of the two, not counting
+# what they call, from the .su files -fstack-usage leaves in builddir. Shared helpers, fonts and
+# maps show up in the symbol list instead. Sizes come from nm -S and the
+# DWARF info, so the ELF needs debug info; set NM and OBJDUMP for a cross
+# toolchain (see the memory target in the Makefile).
+#
+# Static SRAM does not include the stack; the stack line of the profiler
+# (profiler.h) and the stack column of the bench show how much of the
+# rest is used at run time.
+
+ELF=$1
+SKETCH=$2
+BUILDDIR=$3
+NM=${NM:-nm}
+OBJDUMP=${OBJDUMP:-objdump}
+FLASHSIZE=${FLASHSIZE:-30720} # ATmega328 less a 2KB bootloader
+SRAMSIZE=${SRAMSIZE:-2048}
+SYMBOLS=${SYMBOLS:-30}
+
+if [ -z "$ELF" ] || [ -z "$SKETCH" ]; then
+  echo "usage: $0 sketch.elf sketchdir [builddir]" >&2
+  exit 1
+fi
+
+TMP=${TMPDIR:-/tmp}/memreport.$$
+mkdir -p "$TMP" || exit 1
+trap 'rm -rf "$TMP"' EXIT
+
+# size type name, one line per sized symbol
+"$NM" -S -C --size-sort -t d "$ELF" | awk '
+  NF >= 4 {
+    name = $4
+    for (i = 5; i <= NF; i++) name = name " " $i
+    printf "%d\t%s\t%s\n", $2 + 0, $3, name
+  }' > "$TMP/symbols" || exit 1
+
+# struct name and size
+"$OBJDUMP" --dwarf=info "$ELF" 2>/dev/null | awk '
+  /DW_TAG_structure_type|DW_TAG_union_type/ { inStruct = 1; name = ""; next }
+  /Abbrev Number/ { inStruct = 0 }
+  inStruct && /DW_AT_name/ { name = $NF }
+  inStruct && /DW_AT_byte_size/ && name != "" && !(name in seen) { seen[name] = 1; print name "\t" $NF; inStruct = 0 }
+' > "$TMP/structs"
+
+# function name and stack frame
+if [ -n "$BUILDDIR" ]; then
+  find "$BUILDDIR" -name '*.su' -exec cat {} + 2>/dev/null | awk -F '\t' '
+    {
+      sub(/^[^:]*:[0-9]+:[0-9]+:/, "", $1)
+      if (match($1, /[A-Za-z_0-9]+\(/)) print substr($1, RSTART, RLENGTH - 1) "\t" $2
+    }' > "$TMP/frames"
+fi
+touch "$TMP/frames"
+
+# effect and list, from the effect lists in the sketch
+awk '
+  /effectListAudio\[\]/ { list = "audio" }
+  /effectListNoAudio\[\]/ { list = "noaudio" }
+  list != "" {
+    line = $0
+    sub(/\/\/.*/, "", line)
+    while (match(line, /EFFECT\([A-Za-z_0-9]+\)/)) {
+      print substr(line, RSTART + 7, RLENGTH - 8) "\t" list
+      line = substr(line, RSTART + RLENGTH)
+    }
+    if ($0 ~ /};/) list = ""
+  }' "$SKETCH"/*.ino > "$TMP/effects"
+
+# effectState member type and the effects using it: the member name, or
+# the effects listed in its comment
+awk '
+  /^union/ { inUnion = 1; next }
+  inUnion && /^}/ { inUnion = 0 }
+  inUnion && match($0, /^ *[A-Za-z_0-9]+ +[A-Za-z_0-9]+;/) {
+    split(substr($0, RSTART, RLENGTH), part, /[ ;]+/)
+    type = part[1] == "" ? part[2] : part[1]
+    member = part[1] == "" ? part[3] : part[2]
+    users = member
+    if (match($0, /\/\/.*/)) {
+      users = substr($0, RSTART + 2)
+      gsub(/[ ,]+/, " ", users)
+    }
+    print type "\t" users
+  }' "$SKETCH"/effects.h > "$TMP/states"
+
+awk -F '\t' -v flashSize="$FLASHSIZE" -v sramSize="$SRAMSIZE" '
+  FILENAME ~ /symbols$/ {
+    size = $1; type = $2; name = $3
+    if (type ~ /^[TtWwRr]$/) { flash += size; where = "flash" }
+    else if (type ~ /^[Dd]$/) { flash += size; sram += size; where = "sram" }
+    else if (type ~ /^[Bb]$/) { sram += size; where = "sram" }
+    else next
+    n++
+    symSize[n] = size; symWhere[n] = where; symName[n] = name
+    fn = name
+    sub(/\(.*/, "", fn)
+    if (where == "flash") funcSize[fn] += size
+    next
+  }
+  FILENAME ~ /structs$/ { structSize[$1] = $2; next }
+  FILENAME ~ /frames$/ { if ($2 > frame[$1]) frame[$1] = $2; next }
+  FILENAME ~ /states$/ {
+    count = split($2, users, " ")
+    for (i = 1; i <= count; i++) stateOf[tolower(users[i])] = $1
+    next
+  }
+  FILENAME ~ /effects$/ {
+    if ($1 in lists) {
+      lists[$1] = lists[$1] "," $2
+    } else {
+      order[++effects] = $1
+      lists[$1] = $2
+    }
+  }
+  END {
+    printf "flash\t%d\tof %d\t%d%%\n", flash, flashSize, flash * 100 / flashSize
+    printf "sram\t%d\tof %d\t%d%%\t%d left for the stack\n", sram, sramSize, sram * 100 / sramSize, sramSize - sram
+    print ""
+
+    print "size\tmemory\tsymbol"
+    for (i = n; i > 0 && i > n - '"$SYMBOLS"'; i--) printf "%d\t%s\t%s\n", symSize[i], symWhere[i], symName[i]
+    print ""
+
+    print "effect\tlists\tflash\tstate\tframe"
+    for (i = 1; i <= effects; i++) {
+      e = order[i]
+      state = stateOf[tolower(e)]
+      stack = frame[e] > frame[e "Init"] ? frame[e] : frame[e "Init"]
+      printf "%s\t%s\t%d\t%s\t%s\n", e, lists[e], funcSize[e] + funcSize[e "Init"],
+             state != "" && (state in structSize) ? structSize[state] : 0,
+             stack != "" ? stack : "?"
+    }
+  }' "$TMP/symbols" "$TMP/structs" "$TMP/frames" "$TMP/states" "$TMP/effects"
@@ -0,0 +1,331 @@
+// Sender for the serial remote protocol of a REMOTE build (see remote.h)
+//
+//   remote [-s WxH] [-b baud] device command...
+//
+//   -s  layout size for frames (default 15x15)
+//   -b  baud rate for a real serial port (default 1000000)
+//
+// Commands, run in order, each one waits for the device's answer:
+//
+//   effect N           select effect N of the current list
+//   brightness N       set the brightness, 0-255
+//   autocycle 0|1      auto cycle mode
+//   audio 0|1          switch to the audio or non-audio effect list
+//   frames FILE        stream raw RGB frames, W x H row by row like the
+//                      simulator's -o output
+//   test N FILE        stream N generated frames and save them to FILE as
+//                      the device shows them, then the faults of
+//                      testFaults(), ending on a rejected frame
+//
+// Frames go out as RGB565, the device widens them back to 8 bits a channel.
+// Streaming prints the frame rate and the frames that were not
+// acknowledged. Works with the simulator's -P link as well as a real port.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+// Must match remote.h
+#define REMOTESYNC0 0xC3
+#define REMOTESYNC1 0x3C
+#define REMOTE_EFFECT 1
+#define REMOTE_BRIGHTNESS 2
+#define REMOTE_AUTOCYCLE 3
+#define REMOTE_AUDIO 4
+#define REMOTE_FRAME 16
+#define REMOTEACK 0x06
+#define REMOTENAK 0x15
+
+#define ANSWERMILLIS 500 // longest wait for an answer
+#define OPENMILLIS 2000  // wait this long for the device to appear
+
+int port = -1;
+int width = 15;
+int height = 15;
+
+// Same CRC-8 as utils.h, polynomial 0x07
+uint8_t crc8(const uint8_t *data, size_t length) {
+  uint8_t crc = 0;
+  for (size_t i = 0; i < length; i++) {
+    crc ^= data[i];
+    for (int bit = 0; bit < 8; bit++) crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+  }
+  return crc;
+}
+
+double seconds() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+speed_t baudSpeed(long baud) {
+  switch (baud) {
+    case 115200: return B115200;
+    case 230400: return B230400;
+    case 500000: return B500000;
+    case 1000000: return B1000000;
+    case 2000000: return B2000000;
+  }
+  return 0;
+}
+
+bool openPort(const char *path, long baud) {
+  double start = seconds();
+  while ((port = open(path, O_RDWR | O_NOCTTY)) < 0) {
+    if (errno != ENOENT || seconds() - start > OPENMILLIS / 1000.0) return false;
+    usleep(10000);
+  }
+
+  struct termios settings;
+  if (tcgetattr(port, &settings) < 0) return false;
+  cfmakeraw(&settings);
+  speed_t speed = baudSpeed(baud);
+  if (speed) {
+    cfsetispeed(&settings, speed);
+    cfsetospeed(&settings, speed);
+  }
+  tcsetattr(port, TCSANOW, &settings);
+  tcflush(port, TCIFLUSH);
+  return true;
+}
+
+// Sync, header, payload and crc of a packet
+std::vector<uint8_t> makePacket(uint8_t command, const uint8_t *payload, size_t length) {
+  std::vector<uint8_t> packet;
+  packet.push_back(REMOTESYNC0);
+  packet.push_back(REMOTESYNC1);
+  packet.push_back(command);
+  packet.push_back(length & 0xFF);
+  packet.push_back(length >> 8);
+  packet.insert(packet.end(), payload, payload + length);
+  packet.push_back(crc8(&packet[2], packet.size() - 2));
+  return packet;
+}
+
+// Write bytes and wait for the answer: REMOTEACK, REMOTENAK or -1 on timeout
+int exchange(const std::vector<uint8_t> &bytes) {
+  if (write(port, bytes.data(), bytes.size()) != (ssize_t)bytes.size()) return -1;
+
+  // anything else on the line (e.g. a stray byte of an earlier answer) is skipped
+  struct pollfd wait = {port, POLLIN, 0};
+  double deadline = seconds() + ANSWERMILLIS / 1000.0;
+  while (seconds() < deadline) {
+    if (poll(&wait, 1, 10) <= 0) continue;
+    uint8_t answer;
+    if (read(port, &answer, 1) != 1) continue;
+    if (answer == REMOTEACK || answer == REMOTENAK) return answer;
+  }
+  return -1;
+}
+
+int sendPacket(uint8_t command, const uint8_t *payload, size_t length) {
+  return exchange(makePacket(command, payload, length));
+}
+
+// RGB frame to the RGB565 payload of REMOTE_FRAME, little endian
+void encodeFrame(const uint8_t *frame, size_t pixels, std::vector<uint8_t> &payload) {
+  payload.resize(pixels * 2);
+  for (size_t i = 0; i < pixels; i++) {
+    const uint8_t *pixel = frame + i * 3;
+    uint16_t rgb565 = (pixel[0] >> 3) << 11 | (pixel[1] >> 2) << 5 | pixel[2] >> 3;
+    payload[i * 2] = rgb565 & 0xFF;
+    payload[i * 2 + 1] = rgb565 >> 8;
+  }
+}
+
+// The frame as remote.h decodes the payload, top bits repeated
+void decodeFrame(const std::vector<uint8_t> &payload, uint8_t *frame) {
+  for (size_t i = 0; i < payload.size() / 2; i++) {
+    uint16_t rgb565 = payload[i * 2] | payload[i * 2 + 1] << 8;
+    uint8_t red = rgb565 >> 11;
+    uint8_t green = (rgb565 >> 5) & 0x3F;
+    uint8_t blue = rgb565 & 0x1F;
+    frame[i * 3] = red << 3 | red >> 2;
+    frame[i * 3 + 1] = green << 2 | green >> 4;
+    frame[i * 3 + 2] = blue << 3 | blue >> 2;
+  }
+}
+
+// Row by row test pattern, different in every frame
+void testFrame(uint8_t *frame, int index) {
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      uint8_t *pixel = frame + (y * width + x) * 3;
+      pixel[0] = x * 17 + index * 3;
+      pixel[1] = y * 17 + index * 5;
+      pixel[2] = (x + y) * 8 ^ index;
+    }
+  }
+}
+
+// Payload of test frame index, and the frame as shown appended to out
+void testPayload(int index, std::vector<uint8_t> &payload, FILE *out) {
+  std::vector<uint8_t> frame(width * height * 3);
+  testFrame(frame.data(), index);
+  encodeFrame(frame.data(), width * height, payload);
+  if (!out) return;
+  decodeFrame(payload, frame.data());
+  fwrite(frame.data(), 1, frame.size(), out);
+}
+
+bool expectAnswer(const char *name, int answer, int expected) {
+  printf("%s: %s\n", name, answer == REMOTEACK ? "ok" : answer == REMOTENAK ? "rejected" : "no answer");
+  return answer == expected;
+}
+
+// Frames the device has to reject and hold back, each followed by a good
+// one, so out shows that nothing came through in between. The last one
+// is rejected: REMOTETIMEOUT later the effect comes back, fading in from
+// black instead of from the broken frame
+bool testFaults(int index, FILE *out) {
+  std::vector<uint8_t> payload;
+  std::vector<uint8_t> packet;
+  bool ok = true;
+
+  testPayload(index++, payload, NULL);
+  packet = makePacket(REMOTE_FRAME, payload.data(), payload.size());
+  packet.back() ^= 0xFF;
+  ok = expectAnswer("frame with a bad crc", exchange(packet), REMOTENAK) && ok;
+  testPayload(index++, payload, out);
+  ok = expectAnswer("next frame", sendPacket(REMOTE_FRAME, payload.data(), payload.size()), REMOTEACK) && ok;
+
+  testPayload(index++, payload, NULL);
+  packet = makePacket(REMOTE_FRAME, payload.data(), payload.size());
+  packet.resize(packet.size() / 2);
+  ok = expectAnswer("frame cut short", exchange(packet), REMOTENAK) && ok;
+  testPayload(index++, payload, out);
+  ok = expectAnswer("next frame", sendPacket(REMOTE_FRAME, payload.data(), payload.size()), REMOTEACK) && ok;
+
+  // a lone first sync byte and a stray second one, then the real packet
+  static const uint8_t garbage[] = {0x00, 0xFF, REMOTESYNC0, 0x55, REMOTESYNC1};
+  testPayload(index++, payload, out);
+  packet = makePacket(REMOTE_FRAME, payload.data(), payload.size());
+  packet.insert(packet.begin(), garbage, garbage + sizeof(garbage));
+  ok = expectAnswer("frame after garbage", exchange(packet), REMOTEACK) && ok;
+
+  testPayload(index++, payload, NULL);
+  packet = makePacket(REMOTE_FRAME, payload.data(), payload.size());
+  packet.back() ^= 0xFF;
+  ok = expectAnswer("last frame, bad crc", exchange(packet), REMOTENAK) && ok;
+  return ok;
+}
+
+struct streamStats {
+  int frames = 0;
+  int naks = 0;
+  int timeouts = 0;
+  double start = seconds();
+};
+
+void sendFrame(const std::vector<uint8_t> &payload, streamStats &stats) {
+  int answer = sendPacket(REMOTE_FRAME, payload.data(), payload.size());
+  stats.frames++;
+  if (answer == REMOTENAK) stats.naks++;
+  if (answer < 0) stats.timeouts++;
+}
+
+// true when every frame was acknowledged
+bool printStats(const streamStats &stats) {
+  double elapsed = seconds() - stats.start;
+  printf("%d frames in %.2f s (%.1f fps), %d not acknowledged, %d timed out\n",
+         stats.frames, elapsed, stats.frames / elapsed, stats.naks, stats.timeouts);
+  return stats.naks == 0 && stats.timeouts == 0;
+}
+
+int usage(const char *name) {
+  fprintf(stderr, "usage: %s [-s WxH] [-b baud] device command...\n"
+          "  effect N | brightness N | autocycle 0|1 | audio 0|1 | frames FILE | test N FILE\n", name);
+  return 2;
+}
+
+int main(int argc, char **argv) {
+  long baud = 1000000;
+  int opt;
+  while ((opt = getopt(argc, argv, "s:b:")) != -1) {
+    switch (opt) {
+      case 's':
+        if (sscanf(optarg, "%dx%d", &width, &height) != 2) return usage(argv[0]);
+        break;
+      case 'b': baud = strtol(optarg, NULL, 10); break;
+      default: return usage(argv[0]);
+    }
+  }
+  if (optind >= argc) return usage(argv[0]);
+
+  if (!openPort(argv[optind], baud)) {
+    perror(argv[optind]);
+    return 1;
+  }
+
+  const size_t frameBytes = width * height * 3;
+  std::vector<uint8_t> frame(frameBytes);
+  std::vector<uint8_t> payload;
+  bool ok = true;
+
+  for (int i = optind + 1; i < argc; i++) {
+    const char *command = argv[i];
+    const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+    if (!value) return usage(argv[0]);
+    i++;
+
+    uint8_t setting = strtol(value, NULL, 10);
+    int answer = 0;
+    if (!strcmp(command, "effect")) {
+      answer = sendPacket(REMOTE_EFFECT, &setting, 1);
+    } else if (!strcmp(command, "brightness")) {
+      answer = sendPacket(REMOTE_BRIGHTNESS, &setting, 1);
+    } else if (!strcmp(command, "autocycle")) {
+      answer = sendPacket(REMOTE_AUTOCYCLE, &setting, 1);
+    } else if (!strcmp(command, "audio")) {
+      answer = sendPacket(REMOTE_AUDIO, &setting, 1);
+    } else if (!strcmp(command, "frames")) {
+      FILE *in = fopen(value, "rb");
+      if (!in) {
+        perror(value);
+        return 1;
+      }
+      streamStats stats;
+      while (fread(frame.data(), 1, frameBytes, in) == frameBytes) {
+        encodeFrame(frame.data(), width * height, payload);
+        sendFrame(payload, stats);
+      }
+      fclose(in);
+      ok = printStats(stats) && ok;
+      continue;
+    } else if (!strcmp(command, "test")) {
+      if (i + 1 >= argc) return usage(argv[0]);
+      FILE *out = fopen(argv[++i], "wb");
+      if (!out) {
+        perror(argv[i]);
+        return 1;
+      }
+      streamStats stats;
+      int count = strtol(value, NULL, 10);
+      for (int index = 0; index < count; index++) {
+        testPayload(index, payload, out);
+        sendFrame(payload, stats);
+      }
+      ok = printStats(stats) && ok;
+      ok = testFaults(count, out) && ok;
+      fclose(out);
+      continue;
+    } else {
+      return usage(argv[0]);
+    }
+
+    printf("%s %s: %s\n", command, value, answer == REMOTEACK ? "ok" : answer == REMOTENAK ? "rejected" : "no answer");
+    if (answer != REMOTEACK) ok = false;
+  }
+
+  close(port);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,192 @@
+// The settings journal of settings.h against power loss and old contents
+//
+// Each case fills the host EEPROM with records (or the older fixed
+// layout), runs loadSettings() as at power up and checks the settings it
+// applied:
+//
+//   - a save cut short after every one of its cell writes, at the start of
+//     the ring and where both the ring and the sequence number wrap, loads
+//     the record before it; the whole save loads the new one
+//   - a bad crc on the newest record loads the one before it
+//   - the newest record is found across a wrapped sequence number
+//   - without any record the old layout is loaded, and the first save
+//     replaces it
+//   - with only bad records, the next save still comes out newest
+//
+// Exits 1 if any case fails.
+//
+//   settingstest
+
+#include "Arduino.h"
+#include "FastLED.h"
+#include "EEPROM.h"
+
+// settings from RGBShadesAudioOriginal.ino that utils.h needs
+#define MAXBRIGHTNESS 72
+#define STARTBRIGHTNESS 102
+#define MAXMILLIAMPS 1500
+#define REDMILLIAMPS 16
+#define GREENMILLIAMPS 11
+#define BLUEMILLIAMPS 15
+#define IDLEMILLIAMPS 1
+#define EEPROMDELAY 2000
+
+unsigned long hostMicros = 0;
+uint16_t rand16seed = 1337;
+CFastLED FastLED;
+EEPROMClass EEPROM;
+byte numEffects = 16;
+
+void hostShow(const CRGB *data, int numLeds, uint8_t brightness) {
+}
+
+#include "../XYmap.h"
+#include "../utils.h"
+#include "../settings.h"
+
+struct settingsValues {
+  byte effect;
+  boolean autoCycle;
+  boolean audio;
+  byte brightness;
+  byte palette;
+};
+
+bool failed = false;
+
+void applyValues(const settingsValues &values) {
+  currentEffect = values.effect;
+  autoCycle = values.autoCycle;
+  audioEnabled = values.audio;
+  currentBrightness = values.brightness;
+  currentPaletteChoice = values.palette;
+}
+
+// Settings as they are at power up, before loadSettings()
+void powerUp() {
+  applyValues({0, true, false, STARTBRIGHTNESS, 5});
+  settingsSlot = -1;
+  settingsSequence = 0;
+  memset(savedSettings, 0, sizeof(savedSettings));
+  EEPROM.writesLeft = -1;
+}
+
+// A record as saveSettings() writes it, with a broken crc if asked
+void putRecord(int slot, uint16_t sequence, const settingsValues &values, bool badCrc = false) {
+  applyValues(values);
+  byte *record = EEPROM.data + slot * SETTINGSRECORDSIZE;
+  packSettings(record, sequence);
+  if (badCrc) record[7] ^= 1;
+}
+
+// Values that tell the records apart, from a record number
+settingsValues recordValues(unsigned int n) {
+  return {(byte)(n % 16), (n & 1) != 0, (n & 2) != 0, (byte)(n * 7), (byte)(n % 11)};
+}
+
+void check(const char *name, bool loaded, bool expectLoaded, const settingsValues &expected) {
+  bool ok = loaded == expectLoaded && currentEffect == expected.effect && autoCycle == expected.autoCycle &&
+            audioEnabled == expected.audio && currentBrightness == expected.brightness &&
+            currentPaletteChoice == expected.palette;
+  if (!ok) {
+    printf("%s: loaded %d effect %u autocycle %d audio %d brightness %u palette %u, expected %d %u %d %d %u %u  FAIL\n",
+           name, loaded, currentEffect, autoCycle, audioEnabled, currentBrightness, currentPaletteChoice,
+           expectLoaded, expected.effect, expected.autoCycle, expected.audio, expected.brightness, expected.palette);
+    failed = true;
+  }
+}
+
+// Cut the save of next after each of its cell writes, from contents
+// holding previous as the newest record
+void truncatedSaves(const char *name, const byte *contents, const settingsValues &previous, const settingsValues &next) {
+  memcpy(EEPROM.data, contents, sizeof(EEPROM.data));
+  powerUp();
+  loadSettings();
+  applyValues(next);
+  EEPROM.writes = 0;
+  saveSettings();
+  unsigned long saveWrites = EEPROM.writes;
+
+  for (unsigned long cut = 0; cut <= saveWrites; cut++) {
+    memcpy(EEPROM.data, contents, sizeof(EEPROM.data));
+    powerUp();
+    loadSettings();
+    applyValues(next);
+    EEPROM.writesLeft = cut;
+    saveSettings();
+
+    powerUp();
+    char caseName[64];
+    snprintf(caseName, sizeof(caseName), "%s, cut after %lu writes", name, cut);
+    check(caseName, loadSettings(), true, cut < saveWrites ? previous : next);
+  }
+  printf("%s: save cut after each of its %lu writes\n", name, saveWrites);
+}
+
+int main() {
+  byte contents[E2END + 1];
+
+  // first records after an erased EEPROM
+  memset(EEPROM.data, 0xFF, sizeof(EEPROM.data));
+  powerUp();
+  applyValues(recordValues(1));
+  saveSettings();
+  memcpy(contents, EEPROM.data, sizeof(contents));
+  truncatedSaves("ring start", contents, recordValues(1), recordValues(2));
+
+  // a full ring whose newest record is in the last slot at sequence 0xFFFF
+  for (int slot = 0; slot < SETTINGSSLOTS; slot++) {
+    putRecord(slot, 0xFFFF - (SETTINGSSLOTS - 1) + slot, recordValues(slot));
+  }
+  memcpy(contents, EEPROM.data, sizeof(contents));
+  truncatedSaves("ring and sequence wrap", contents, recordValues(SETTINGSSLOTS - 1), recordValues(200));
+
+  // bad crc on the newest record
+  memset(EEPROM.data, 0xFF, sizeof(EEPROM.data));
+  putRecord(3, 10, recordValues(3));
+  putRecord(4, 11, recordValues(4), true);
+  powerUp();
+  check("bad crc on the newest", loadSettings(), true, recordValues(3));
+  applyValues(recordValues(5));
+  saveSettings();
+  powerUp();
+  check("save after a bad crc", loadSettings(), true, recordValues(5));
+  printf("bad crc on the newest record: the one before it loaded\n");
+
+  // sequence numbers wrap in the middle of the ring, slot 21 is newest
+  for (int slot = 0; slot < SETTINGSSLOTS; slot++) {
+    uint16_t sequence = slot <= 21 ? (uint16_t)(slot - 20) : (uint16_t)(slot - 20 - SETTINGSSLOTS);
+    putRecord(slot, sequence, recordValues(slot));
+  }
+  powerUp();
+  check("wrapped sequence", loadSettings(), true, recordValues(21));
+  printf("wrapped sequence numbers: slot %d newest\n", settingsSlot);
+
+  // old fixed layout, replaced by the first save
+  memset(EEPROM.data, 0xFF, sizeof(EEPROM.data));
+  EEPROM.data[0] = SETTINGSOLDMAGIC;
+  EEPROM.data[1] = 3;
+  EEPROM.data[2] = 0;
+  EEPROM.data[3] = 200;
+  powerUp();
+  settingsValues old = {3, false, false, 200, 5};
+  check("old layout", loadSettings(), false, old);
+  saveSettings();
+  powerUp();
+  check("old layout saved", loadSettings(), true, old);
+  printf("old layout: loaded and saved as a record\n");
+
+  // only bad records, the last good one too far back to be reached
+  memset(EEPROM.data, 0xFF, sizeof(EEPROM.data));
+  putRecord(10, 7, recordValues(10));
+  putRecord(11, 100, recordValues(11), true);
+  powerUp();
+  check("no good record", loadSettings(), false, {0, true, false, STARTBRIGHTNESS, 5});
+  applyValues(recordValues(12));
+  saveSettings();
+  powerUp();
+  check("save after no good record", loadSettings(), true, recordValues(12));
+  printf("no good record: the next save loaded from slot %d, sequence %u\n", settingsSlot, settingsSequence);
+
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,303 @@
+// Headless host simulation of the RGB Shades sketch
+//
+// Builds RGBShadesAudioOriginal.ino against the Arduino/FastLED stand-ins
+// in this directory and runs setup() and loop() on a simulated clock, as
+// fast as the host allows. Every FastLED.show() costs the time a WS2811
+// strip would take, so loop timing resembles the device.
+//
+//   sim [-d ms] [-e effect] [-a] [-m] [-l us] [-b bpm] [-i audio] [-R rate] [-r capture.bin] [-o frames.rgb] [-p] [-H] [-n] [-E eeprom.bin] [-P link]
+//
+//   -d  simulated run time in milliseconds (default 10000)
+//   -e  start on this effect index
+//   -a  use the audio effect list
+//   -m  manual mode, do not auto cycle effects
+//   -l  simulated overhead per loop() pass in microseconds (default 100)
+//   -b  tempo of the synthetic audio signal (default 120, 0 for no beat)
+//   -i  audio input instead of the synthetic signal: a WAV file, or raw
+//       signed 16 bit mono PCM, "-" for stdin (see audioSource.h); the run
+//       ends with it unless -d is given
+//   -R  sample rate of raw PCM input (default 44100)
+//   -r  play back this audio capture, needs a replay build (see audioReplay.h);
+//       the run ends with the capture
+//   -o  append every shown frame to this file as raw RGB, kMatrixWidth x
+//       kMatrixHeight, row by row
+//   -p  print the last frame to the terminal using 24 bit color
+//   -H  print a hash of every shown frame to stdout at the end, for golden runs
+//   -n  print the number of effects in the selected list and exit
+//   -E  load EEPROM contents from this file and save them back at exit
+//   -P  connect Serial to a new pseudo terminal, linked from this path, and
+//       run in real time; bytes read cost their time on the line at the
+//       sketch's baud rate (see remote.h and host/remote.cpp)
+//
+// Raw frames can be viewed with e.g.
+//   ffmpeg -f rawvideo -pix_fmt rgb24 -s 15x15 -r 100 -i frames.rgb out.mp4
+//
+// Built with -DBENCHMARK it only runs setup(), which prints the effect
+// benchmark table (see benchmark.h) and exits. Built with -DPROFILE it
+// prints the loop phase statistics (see profiler.h) at the end of the run.
+
+#include "Arduino.h"
+#include "FastLED.h"
+#include "EEPROM.h"
+
+#include <unistd.h>
+#include <time.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <algorithm>
+
+unsigned long hostMicros = 0;
+uint16_t rand16seed = 1337;
+HardwareSerial Serial;
+CFastLED FastLED;
+EEPROMClass EEPROM;
+
+#include "../RGBShadesAudioOriginal.ino"
+
+#define WS2811MICROS 30 // time to clock out one pixel at 800kHz
+#define LATCHMICROS 50
+
+FILE *frameFile = NULL;
+unsigned long shownFrames = 0;
+uint32_t shownFramesHash = 2166136261u; // FNV-1a over every shown pixel and brightness
+
+// Shown frames go to the frame file in XY order, and cost strip time
+void hostShow(const CRGB *data, int numLeds, uint8_t brightness) {
+  shownFrames++;
+  hostMicros += (unsigned long)numLeds * WS2811MICROS + LATCHMICROS;
+
+  shownFramesHash = (shownFramesHash ^ brightness) * 16777619u;
+  for (byte y = 0; y < kMatrixHeight; y++) {
+    for (byte x = 0; x < kMatrixWidth; x++) {
+      const CRGB &pixel = leds[XY(x, y)];
+      for (byte i = 0; i < 3; i++) shownFramesHash = (shownFramesHash ^ pixel.raw[i]) * 16777619u;
+      if (frameFile) fwrite(pixel.raw, 1, 3, frameFile);
+    }
+  }
+}
+
+// Buttons are never pressed
+int hostDigitalRead(uint8_t pin) {
+  return HIGH;
+}
+
+#include "audioSource.h"
+
+// Serial output goes to stdout and there is no serial input, unless -P
+// connects the port to a pseudo terminal
+int serialPty = -1;
+unsigned long serialByteMicros = 0; // a byte with start and stop bits at the sketch's baud rate
+byte serialBuffer[4096];
+int serialHead = 0;
+int serialCount = 0;
+
+// Real time, in simulated microseconds, for runs with -P
+struct timespec paceWall;
+unsigned long paceMicros = 0;
+
+unsigned long wallMicros() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return paceMicros + (now.tv_sec - paceWall.tv_sec) * 1000000UL + (now.tv_nsec - paceWall.tv_nsec) / 1000;
+}
+
+void hostSerialBegin(unsigned long baud) {
+  serialByteMicros = 10000000UL / baud;
+}
+
+int hostSerialRead() {
+  if (serialPty < 0) return -1;
+  if (serialHead == serialCount) {
+    unsigned long now = wallMicros();
+    // time passes while the sketch waits for input, a byte at a time: a
+    // host that fell behind would otherwise jump ahead in the middle of a pass
+    if (hostMicros < now) hostMicros += std::min(now - hostMicros, serialByteMicros);
+    ssize_t count = read(serialPty, serialBuffer, sizeof(serialBuffer));
+    if (count <= 0) return -1;
+    serialHead = 0;
+    serialCount = count;
+  }
+  hostMicros += serialByteMicros;
+  return serialBuffer[serialHead++];
+}
+
+void hostSerialWrite(const uint8_t *data, size_t length) {
+  if (serialPty >= 0) {
+    if (write(serialPty, data, length) < 0) perror("serial");
+  } else {
+    fwrite(data, 1, length, stdout);
+  }
+}
+
+// New pseudo terminal in raw mode, with a symbolic link to its name
+bool openSerialPty(const char *link) {
+  serialPty = posix_openpt(O_RDWR | O_NOCTTY);
+  if (serialPty < 0 || grantpt(serialPty) < 0 || unlockpt(serialPty) < 0) return false;
+  const char *name = ptsname(serialPty);
+
+  // kept open, so the pty stays up between senders
+  int device = open(name, O_RDWR | O_NOCTTY);
+  if (device < 0) return false;
+  struct termios settings;
+  tcgetattr(device, &settings);
+  cfmakeraw(&settings);
+  tcsetattr(device, TCSANOW, &settings);
+
+  fcntl(serialPty, F_SETFL, O_NONBLOCK);
+  unlink(link);
+  if (symlink(name, link) < 0) return false;
+  clock_gettime(CLOCK_MONOTONIC, &paceWall);
+  return true;
+}
+
+void printFrame() {
+  for (byte y = 0; y < kMatrixHeight; y++) {
+    for (byte x = 0; x < kMatrixWidth; x++) {
+      const CRGB &pixel = leds[XY(x, y)];
+      printf("\x1b[48;2;%d;%d;%dm  ", pixel.r, pixel.g, pixel.b);
+    }
+    printf("\x1b[0m\n");
+  }
+}
+
+int main(int argc, char **argv) {
+  unsigned long runMillis = 10000;
+  bool runSet = false;
+  const char *audioPath = NULL;
+  double rawRate = 44100;
+  unsigned long loopMicros = 100;
+  int startEffect = -1;
+  bool audioList = false;
+  bool manual = false;
+  bool printLast = false;
+  bool printHash = false;
+  bool printCount = false;
+  const char *eepromPath = NULL;
+  const char *ptyLink = NULL;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "d:e:aml:b:i:R:r:o:pHnE:P:")) != -1) {
+    switch (opt) {
+      case 'd':
+        runMillis = strtoul(optarg, NULL, 10);
+        runSet = true;
+        break;
+      case 'e': startEffect = atoi(optarg); break;
+      case 'a': audioList = true; break;
+      case 'm': manual = true; break;
+      case 'l': loopMicros = strtoul(optarg, NULL, 10); break;
+      case 'b': testInput.beatsPerMinute = atof(optarg); break;
+      case 'i': audioPath = optarg; break;
+      case 'R': rawRate = atof(optarg); break;
+      case 'r':
+#ifdef AUDIOREPLAY
+        audioReplayFile = fopen(optarg, "rb");
+        if (!audioReplayFile) {
+          perror(optarg);
+          return 1;
+        }
+        break;
+#else
+        fprintf(stderr, "-r needs a build with AUDIOINPUT=\"audioReplay.h\"\n");
+        return 1;
+#endif
+      case 'o':
+        frameFile = fopen(optarg, "wb");
+        if (!frameFile) {
+          perror(optarg);
+          return 1;
+        }
+        break;
+      case 'p': printLast = true; break;
+      case 'H': printHash = true; break;
+      case 'n': printCount = true; break;
+      case 'E': eepromPath = optarg; break;
+      case 'P':
+        ptyLink = optarg;
+        if (!openSerialPty(ptyLink)) {
+          perror(ptyLink);
+          return 1;
+        }
+        break;
+      default:
+        fprintf(stderr, "usage: %s [-d ms] [-e effect] [-a] [-m] [-l us] [-b bpm] [-i audio] [-R rate] [-r capture.bin] [-o frames.rgb] [-p] [-H] [-n] [-E eeprom.bin] [-P link]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  if (audioPath) {
+    if (!openAudioInput(audioPath, rawRate)) {
+      perror(audioPath);
+      return 1;
+    }
+    if (!runSet) runMillis = (unsigned long)-1 / 1000; // until the input ends
+  }
+
+  if (eepromPath) {
+    FILE *f = fopen(eepromPath, "rb");
+    if (f) {
+      fread(EEPROM.data, 1, sizeof(EEPROM.data), f);
+      fclose(f);
+    }
+  }
+
+  setup();
+#ifdef BENCHMARK
+  return 0; // setup() has printed the benchmark table
+#endif
+
+  if (audioList) {
+    audioEnabled = true;
+    numEffects = numEffectsAudio;
+  }
+  if (printCount) {
+    printf("%d\n", numEffects);
+    return 0;
+  }
+  if (manual) autoCycle = false;
+  if (startEffect >= 0) currentEffect = startEffect % numEffects;
+  selectEffect(currentEffect);
+
+  struct timespec wallStart, wallEnd;
+  clock_gettime(CLOCK_MONOTONIC, &wallStart);
+
+  unsigned long loops = 0;
+  while (hostMicros < runMillis * 1000) {
+#ifdef AUDIOREPLAY
+    if (audioReplayEnded) break;
+#endif
+    if (audioInputEnded) break;
+    loop();
+    hostMicros += loopMicros;
+    loops++;
+    if (serialPty >= 0) {
+      unsigned long now = wallMicros();
+      if (hostMicros > now) usleep(hostMicros - now);
+    }
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &wallEnd);
+  double wallSeconds = (wallEnd.tv_sec - wallStart.tv_sec) + (wallEnd.tv_nsec - wallStart.tv_nsec) / 1e9;
+  double simSeconds = hostMicros / 1e6;
+
+#ifdef PROFILE
+  profileDump();
+#endif
+  if (printLast) printFrame();
+  if (printHash) printf("%08x\n", shownFramesHash);
+  if (frameFile) fclose(frameFile);
+  if (ptyLink) unlink(ptyLink);
+
+  if (eepromPath) {
+    FILE *f = fopen(eepromPath, "wb");
+    if (f) {
+      fwrite(EEPROM.data, 1, sizeof(EEPROM.data), f);
+      fclose(f);
+    }
+  }
+
+  fprintf(stderr, "%dx%d, %.2f s simulated in %.3f s (%.0fx), %lu loops, %lu frames shown (%.1f fps), %lu unchanged, peak %u mA, %u BPM\n",
+          kMatrixWidth, kMatrixHeight, simSeconds, wallSeconds, simSeconds / wallSeconds,
+          loops, shownFrames, shownFrames / simSeconds, showsSkipped, peakMilliamps, beatsPerMinute);
+  return 0;
+}
@@ -0,0 +1,48 @@
+// Lock-free triple buffer, one writer thread and one reader thread
+//
+// The writer fills back() and publishes it, the reader takes the newest
+// published slot with update() and reads front(). Neither side ever
+// waits: a slot published while the reader is busy replaces the one it
+// has not taken yet, so the reader always gets the latest and never a
+// half written one. The only shared word is the index of the middle slot,
+// with a flag for "published since the reader last took it".
+
+#ifndef HOST_TRIPLEBUFFER_H
+#define HOST_TRIPLEBUFFER_H
+
+#include <atomic>
+#include <stdint.h>
+
+template <typename T> class TripleBuffer {
+  public:
+    T &back() {
+      return slots[backSlot];
+    }
+
+    // Hand back() to the reader, the writer continues in the old middle slot
+    void publish() {
+      backSlot = middle.exchange(backSlot | FRESH, std::memory_order_acq_rel) & SLOTMASK;
+    }
+
+    // Take the newest published slot, false if there is none since the last call
+    bool update() {
+      if (!(middle.load(std::memory_order_relaxed) & FRESH)) return false;
+      frontSlot = middle.exchange(frontSlot, std::memory_order_acq_rel) & SLOTMASK;
+      return true;
+    }
+
+    const T &front() const {
+      return slots[frontSlot];
+    }
+
+  private:
+    static const uint8_t SLOTMASK = 3;
+    static const uint8_t FRESH = 4;
+
+    T slots[3];
+    uint8_t backSlot = 0;  // writer only
+    alignas(64) std::atomic<uint8_t> middle{1};
+    alignas(64) uint8_t frontSlot = 2; // reader only
+};
+
+#endif
@@ -0,0 +1,194 @@
+// The generated XY tables against the hand written ones they replaced
+//
+// Each layout is compiled into a namespace of its own: the two XY maps of
+// the sketch, and the Kickstarter shades mask that XYmap.h only has in a
+// comment. Every cell and an out of bounds coordinate are looked up with
+// XY() and compared with the tables the maps had before they were
+// generated (XYmap.h and XYmap_panel.h up to the "Generate XY tables"
+// commit). A 20x16 column major layout with holes, over 255 pixels so it
+// takes the uint16_t table, has no old table and is compared with
+// referenceTable(), which numbers the pixels by walking the strip.
+// Exits 1 on the first layout that differs.
+//
+//   xymaptest
+
+#include "Arduino.h"
+#include "FastLED.h"
+
+namespace shades {
+#include "../XYmap.h"
+}
+
+#undef XYLAYOUT_MASK
+#undef XYLAYOUT_FLAGS
+#undef NUM_LEDS
+#undef LAST_VISIBLE_LED
+
+namespace panel {
+#include "../XYmap_panel.h"
+}
+
+#undef XYLAYOUT_MASK
+#undef XYLAYOUT_FLAGS
+#undef NUM_LEDS
+#undef LAST_VISIBLE_LED
+
+namespace kickstarter {
+const uint8_t kMatrixWidth = 16;
+const uint8_t kMatrixHeight = 5;
+
+#define XYLAYOUT_MASK \
+  ".##############." \
+  "################" \
+  "#######..#######" \
+  "#######..#######" \
+  ".#####....#####."
+#define XYLAYOUT_FLAGS XYLAYOUT_SERPENTINE
+
+#include "../XYlayout.h"
+}
+
+#undef XYLAYOUT_MASK
+#undef XYLAYOUT_FLAGS
+#undef NUM_LEDS
+#undef LAST_VISIBLE_LED
+
+namespace large {
+const uint8_t kMatrixWidth = 20;
+const uint8_t kMatrixHeight = 16;
+
+#define XYLAYOUT_MASK \
+  "..################.." \
+  "####################" \
+  "####################" \
+  "####################" \
+  "####################" \
+  "####################" \
+  "####################" \
+  "########....########" \
+  "########....########" \
+  "####################" \
+  "####################" \
+  "####################" \
+  "####################" \
+  "####################" \
+  "####################" \
+  "..################.."
+#define XYLAYOUT_FLAGS (XYLAYOUT_COLUMNMAJOR | XYLAYOUT_SERPENTINE | XYLAYOUT_FLIPFIRST)
+
+#include "../XYlayout.h"
+
+const char mask[] = XYLAYOUT_MASK;
+const byte flags = XYLAYOUT_FLAGS;
+const unsigned int pixels = NUM_LEDS;
+}
+
+static_assert(sizeof(large::ledindex_t) == 2, "the large layout must take the uint16_t table");
+static_assert(large::xyVisibleLeds() >= 256, "the large layout must have over 255 visible pixels");
+
+// The old tables, copied as they were
+const uint8_t oldShadesTable[] = {
+  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15,
+  31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17, 16,
+  32, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, 44, 45, 46, 47,
+  63, 62, 61, 60, 59, 58, 57, 56, 55, 54, 53, 52, 51, 50, 49, 48,
+  64, 65, 66, 67, 68, 69, 70, 71, 72, 73, 74, 75, 76, 77, 78, 79
+};
+
+const uint8_t oldKickstarterTable[] = {
+  68,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 69,
+  29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17, 16, 15, 14,
+  30, 31, 32, 33, 34, 35, 36, 70, 71, 37, 38, 39, 40, 41, 42, 43,
+  57, 56, 55, 54, 53, 52, 51, 72, 73, 50, 49, 48, 47, 46, 45, 44,
+  74, 58, 59, 60, 61, 62, 75, 76, 77, 78, 63, 64, 65, 66, 67, 79
+};
+
+const uint8_t oldPanelTable[] = {
+  14, 218, 43, 219, 72, 220, 101, 221, 130, 222, 159, 223, 188, 224, 217,
+  13,  15, 42,  44, 71,  73, 100, 102, 129, 131, 158, 160, 187, 189, 216,
+  12,  16, 41,  45, 70,  74,  99, 103, 128, 132, 157, 161, 186, 190, 215,
+  11,  17, 40,  46, 69,  75,  98, 104, 127, 133, 156, 162, 185, 191, 214,
+  10,  18, 39,  47, 68,  76,  97, 105, 126, 134, 155, 163, 184, 192, 213,
+  9,  19, 38,  48, 67,  77,  96, 106, 125, 135, 154, 164, 183, 193, 212,
+  8,  20, 37,  49, 66,  78,  95, 107, 124, 136, 153, 165, 182, 194, 211,
+  7,  21, 36,  50, 65,  79,  94, 108, 123, 137, 152, 166, 181, 195, 210,
+  6,  22, 35,  51, 64,  80,  93, 109, 122, 138, 151, 167, 180, 196, 209,
+  5,  23, 34,  52, 63,  81,  92, 110, 121, 139, 150, 168, 179, 197, 208,
+  4,  24, 33,  53, 62,  82,  91, 111, 120, 140, 149, 169, 178, 198, 207,
+  3,  25, 32,  54, 61,  83,  90, 112, 119, 141, 148, 170, 177, 199, 206,
+  2,  26, 31,  55, 60,  84,  89, 113, 118, 142, 147, 171, 176, 200, 205,
+  1,  27, 30,  56, 59,  85,  88, 114, 117, 143, 146, 172, 175, 201, 204,
+  0,  28, 29,  57, 58,  86,  87, 115, 116, 144, 145, 173, 174, 202, 203,
+};
+
+// Every cell of one layout, then the out of bounds index, which the old
+// maps made the first hidden pixel, LAST_VISIBLE_LED + 1
+bool compareLayout(const char *name, unsigned int (*xy)(byte, byte), byte width, byte height,
+                   const uint8_t *oldTable, unsigned int oldOutOfBounds, const unsigned int *wideTable = NULL) {
+  unsigned int cells = width * height;
+  for (unsigned int cell = 0; cell < cells; cell++) {
+    unsigned int index = xy(cell % width, cell / width);
+    unsigned int expected = wideTable ? wideTable[cell] : oldTable[cell];
+    if (index != expected) {
+      printf("xymap %s: XY(%u, %u) is %u, expected %u\n", name, cell % width, cell / width, index, expected);
+      return false;
+    }
+  }
+  if (xy(width, 0) != oldOutOfBounds || xy(0, height) != oldOutOfBounds) {
+    printf("xymap %s: out of bounds is %u, the old map returned %u\n", name, xy(width, 0), oldOutOfBounds);
+    return false;
+  }
+  printf("xymap %s: all %u cells match\n", name, cells);
+  return true;
+}
+
+// XY table of a mask worked out the plain way: walk the strip and number
+// the visible pixels, then number the holes in row order after them.
+// Returns the first hidden pixel, for out of bounds coordinates.
+unsigned int referenceTable(const char *mask, byte width, byte height, byte flags, unsigned int *table) {
+  bool columns = flags & XYLAYOUT_COLUMNMAJOR;
+  unsigned int strips = columns ? width : height;
+  unsigned int stripLength = columns ? height : width;
+  unsigned int index = 0;
+  for (unsigned int strip = 0; strip < strips; strip++) {
+    bool reversed = ((flags & XYLAYOUT_SERPENTINE) && (strip & 1)) != bool(flags & XYLAYOUT_FLIPFIRST);
+    for (unsigned int step = 0; step < stripLength; step++) {
+      unsigned int along = reversed ? stripLength - 1 - step : step;
+      unsigned int cell = columns ? along * width + strip : strip * width + along;
+      if (mask[cell] != '.') table[cell] = index++;
+    }
+  }
+  unsigned int firstHidden = index;
+  for (unsigned int cell = 0; cell < (unsigned int)width * height; cell++) {
+    if (mask[cell] == '.') table[cell] = index++;
+  }
+  return firstHidden;
+}
+
+unsigned int shadesXY(byte x, byte y) {
+  return shades::XY(x, y);
+}
+
+unsigned int panelXY(byte x, byte y) {
+  return panel::XY(x, y);
+}
+
+unsigned int kickstarterXY(byte x, byte y) {
+  return kickstarter::XY(x, y);
+}
+
+unsigned int largeXY(byte x, byte y) {
+  return large::XY(x, y);
+}
+
+int main() {
+  unsigned int largeTable[large::pixels];
+  unsigned int largeOutOfBounds = referenceTable(large::mask, large::kMatrixWidth, large::kMatrixHeight,
+                                                 large::flags, largeTable);
+
+  bool match = compareLayout("shades", shadesXY, shades::kMatrixWidth, shades::kMatrixHeight, oldShadesTable, 80) &&
+               compareLayout("kickstarter", kickstarterXY, kickstarter::kMatrixWidth, kickstarter::kMatrixHeight, oldKickstarterTable, 68) &&
+               compareLayout("panel", panelXY, panel::kMatrixWidth, panel::kMatrixHeight, oldPanelTable, 218) &&
+               compareLayout("large", largeXY, large::kMatrixWidth, large::kMatrixHeight, NULL, largeOutOfBounds, largeTable);
+  return match ? 0 : 1;
+}
@@ -0,0 +1,159 @@
+// Loop phase timing, only compiled in when PROFILE is defined
+//
+// Each phase of loop() is timed with micros(). Per phase we keep the
+// count, min/avg/max and a histogram with power of two buckets, plus a
+// ring of the last few loop() durations. Send 'p' over Serial to print
+// the statistics, 'r' to reset them.
+//
+// A stack line follows with the free SRAM between heap and stack now and
+// the part of it the stack has not touched since the last reset (see
+// sram.h), with the MAX9814 input an fft line with the last frame's
+// microseconds, the sample overruns and the dropped frames (see
+// audioMAX9814.h), then the scheduler's per task lateness (see scheduler.h).
+// A render task that is regularly late means the layout can no longer
+// keep up with the effect's frame rate.
+
+#ifdef PROFILE
+
+#define PHASE_BUTTONS 0
+#define PHASE_EEPROM 1
+#define PHASE_AUDIO 2
+#define PHASE_EFFECT 3
+#define PHASE_SHOW 4
+#define NUMPHASES 5
+
+#define PROFILEBUCKETS 8       // <64us, <128us, ... <4096us, 4096us and up
+#define PROFILEFIRSTBUCKET 6   // log2 of the first bucket limit
+#define PROFILEHISTORY 16      // loop() durations kept, power of two
+
+const char phaseName0[] PROGMEM = "buttons";
+const char phaseName1[] PROGMEM = "eeprom";
+const char phaseName2[] PROGMEM = "audio";
+const char phaseName3[] PROGMEM = "effect";
+const char phaseName4[] PROGMEM = "show";
+const char * const phaseNames[NUMPHASES] PROGMEM = {
+  phaseName0, phaseName1, phaseName2, phaseName3, phaseName4
+};
+
+struct phaseStats {
+  unsigned int count;
+  unsigned int minMicros;
+  unsigned int maxMicros;
+  unsigned long totalMicros;
+  unsigned int histogram[PROFILEBUCKETS];
+};
+
+phaseStats profileStats[NUMPHASES];
+unsigned int loopHistory[PROFILEHISTORY]; // most recent loop() durations in us
+byte loopHistoryHead = 0;
+unsigned long profileMark; // start of the phase being timed
+unsigned long loopMark;    // start of the current loop() pass
+
+void profileReset() {
+  memset(profileStats, 0, sizeof(profileStats));
+  for (byte i = 0; i < NUMPHASES; i++) profileStats[i].minMicros = 0xFFFF;
+  memset(loopHistory, 0, sizeof(loopHistory));
+  resetTaskStats();
+  paintStack();
+}
+
+void profileRecord(byte phase, unsigned long elapsed) {
+  phaseStats &stats = profileStats[phase];
+  unsigned int us = elapsed > 0xFFFF ? 0xFFFF : elapsed;
+
+  if (stats.count < 0xFFFF) stats.count++;
+  if (us < stats.minMicros) stats.minMicros = us;
+  if (us > stats.maxMicros) stats.maxMicros = us;
+  stats.totalMicros += us;
+
+  byte bucket = 0;
+  for (unsigned int limit = us >> PROFILEFIRSTBUCKET; limit && bucket < PROFILEBUCKETS - 1; limit >>= 1) bucket++;
+  if (stats.histogram[bucket] < 0xFFFF) stats.histogram[bucket]++;
+}
+
+void profileLoopStart() {
+  unsigned long now = micros();
+  loopHistory[loopHistoryHead] = now - loopMark;
+  loopHistoryHead = (loopHistoryHead + 1) & (PROFILEHISTORY - 1);
+  loopMark = now;
+}
+
+void profileStart() {
+  profileMark = micros();
+}
+
+void profileEnd(byte phase) {
+  profileRecord(phase, micros() - profileMark);
+}
+
+void profileDump() {
+  Serial.println(F("phase\tcount\tmin\tavg\tmax\t<64\t<128\t<256\t<512\t<1k\t<2k\t<4k\t4k+"));
+  for (byte i = 0; i < NUMPHASES; i++) {
+    phaseStats &stats = profileStats[i];
+    Serial.print((const __FlashStringHelper *)pgm_read_ptr(&phaseNames[i]));
+    Serial.print('\t');
+    Serial.print(stats.count);
+    Serial.print('\t');
+    Serial.print(stats.count ? stats.minMicros : 0);
+    Serial.print('\t');
+    Serial.print(stats.count ? stats.totalMicros / stats.count : 0);
+    Serial.print('\t');
+    Serial.print(stats.maxMicros);
+    for (byte b = 0; b < PROFILEBUCKETS; b++) {
+      Serial.print('\t');
+      Serial.print(stats.histogram[b]);
+    }
+    Serial.println();
+  }
+
+  Serial.print(F("loop"));
+  for (byte i = 0; i < PROFILEHISTORY; i++) {
+    Serial.print('\t');
+    Serial.print(loopHistory[(loopHistoryHead + i) & (PROFILEHISTORY - 1)]);
+  }
+  Serial.println();
+
+  Serial.print(F("stack\t"));
+  Serial.print(sramFree());
+  Serial.print('\t');
+  Serial.println(stackUnused());
+
+#ifdef FFTSIZE
+  Serial.print(F("fft\t"));
+  Serial.print(fftMicros);
+  Serial.print('\t');
+  Serial.print(sampleOverruns);
+  Serial.print('\t');
+  Serial.println(fftDropped);
+#endif
+
+  dumpTaskStats();
+}
+
+// Handle profiler commands from the serial port
+void profileCheckSerial() {
+  while (Serial.available()) {
+    switch (Serial.read()) {
+      case 'p':
+        profileDump();
+        break;
+      case 'r':
+        profileReset();
+        break;
+    }
+  }
+}
+
+#define PROFILE_SETUP() do { Serial.begin(115200); profileReset(); } while (0)
+#define PROFILE_LOOP() do { profileLoopStart(); profileCheckSerial(); } while (0)
+#define PROFILE_START() profileStart()
+#define PROFILE_END(phase) profileEnd(phase)
+
+#else
+
+#define PROFILE_SETUP()
+#define PROFILE_LOOP()
+#define PROFILE_START()
+#define PROFILE_END(phase)
+
+#endif
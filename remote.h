@@ -0,0 +1,239 @@
+// Remote control and frame streaming over Serial, only compiled in when
+// REMOTE is defined
+//
+// Packets, lengths little endian:
+//
+//   0   2  sync, 0xC3 0x3C
+//   2   1  command, REMOTE_ below
+//   3   2  payload length
+//   5   n  payload
+//   5+n 1  crc8() of bytes 2 to 4+n
+//
+//   REMOTE_EFFECT      1 byte   select an effect of the current list
+//   REMOTE_BRIGHTNESS  1 byte   currentBrightness
+//   REMOTE_AUTOCYCLE   1 byte   0 or 1
+//   REMOTE_AUDIO       1 byte   0 or 1, switches effect lists
+//   REMOTE_FRAME       NUM_LEDS * 2 bytes, one RGB565 word per pixel row
+//                      by row like the host simulator's -o output, holes
+//                      included
+//
+// The device answers every packet with REMOTEACK, or REMOTENAK when the
+// crc, the length or the setting is wrong or the packet was cut short. A
+// frame is acknowledged after it was shown, and the sender waits for the
+// answer before the next packet: FastLED keeps interrupts off while it
+// clocks the strip out, so anything arriving then would be lost.
+//
+// Frame payloads are decoded straight into leds[] through the XY table as
+// they arrive, there is no SRAM left for a second frame buffer. A frame
+// that fails is not shown, the strip keeps the last good one until the
+// next frame passes (REMOTE_HOLDSSHOW). Frames take over from the running
+// effect; it starts again REMOTETIMEOUT after the last one.
+//
+// The line and the strip take turns, so the frame rate is bounded by both.
+// At 1Mbaud a panel frame takes 4.6ms on the line and 6.8ms on the strip,
+// about 87 frames a second against the strip's own 147; the 16x5 shades
+// reach about 220. A byte arrives every 160 cycles, time enough for the
+// crc and the RGB565 decode by estimate. REMOTEBAUD 2000000 would cut the
+// line time in half, but leaves 80 cycles a byte; that has not been
+// measured on a board yet, and a board that cannot keep up loses frames
+// to the crc.
+// REMOTE, PROFILE and AUDIOCAPTURE all use Serial, build with one of them.
+// host/remote.cpp is a sender, host/Makefile has a loopback test.
+
+#ifdef REMOTE
+
+#define REMOTEBAUD 1000000
+#define REMOTESYNC0 0xC3
+#define REMOTESYNC1 0x3C
+#define REMOTE_EFFECT 1
+#define REMOTE_BRIGHTNESS 2
+#define REMOTE_AUTOCYCLE 3
+#define REMOTE_AUDIO 4
+#define REMOTE_FRAME 16
+#define REMOTEACK 0x06
+#define REMOTENAK 0x15
+#define REMOTEMAXARGS 4
+#define REMOTEBYTEMICROS 2000 // longest gap inside a packet
+#define REMOTETIMEOUT 2000    // milliseconds after the last frame until the effect is back
+
+boolean remoteAckPending = false; // a frame waits for its show to be acknowledged
+boolean remoteFrameBad = false;   // leds[] holds a frame that failed, the strip the last good one
+unsigned long remoteFrameMillis;
+
+// Effect slot while frames are streamed, the frames are drawn by remotePoll()
+void remoteFrameRender() {
+  effectDelay = 100;
+}
+
+// Next byte of a packet, -1 when the sender stopped
+int remoteReadByte() {
+  if (Serial.available()) return Serial.read();
+  unsigned long start = micros();
+  while (!Serial.available()) {
+    if (micros() - start > REMOTEBYTEMICROS) return -1;
+  }
+  return Serial.read();
+}
+
+// Decode a frame payload into leds[], returns the running crc or -1 if cut short
+// RGB565 is widened by repeating the top bits, so 0 and full scale survive
+int remoteReadFrame(byte crc) {
+  for (ledindex_t i = 0; i < NUM_LEDS; i++) {
+    int low = remoteReadByte();
+    int high = remoteReadByte();
+    if (low < 0 || high < 0) return -1;
+    crc = crc8Byte(crc8Byte(crc, low), high);
+
+    unsigned int rgb565 = low | ((unsigned int)high << 8);
+    byte red = rgb565 >> 11;
+    byte green = (rgb565 >> 5) & 0x3F;
+    byte blue = rgb565 & 0x1F;
+    CRGB &pixel = leds[xyRead(&xyTable.index[i])];
+    pixel.r = (red << 3) | (red >> 2);
+    pixel.g = (green << 2) | (green >> 4);
+    pixel.b = (blue << 3) | (blue >> 2);
+  }
+  return crc;
+}
+
+// Stop the effect and leave leds[] to the frames
+void startRemoteFrames() {
+  if (effectTeardown) effectTeardown();
+  effectTeardown = NULL;
+  effectRender = remoteFrameRender;
+  crossfadeActive = false;
+}
+
+void remoteSettingChanged() {
+  eepromMillis = currentMillis;
+  eepromOutdated = true;
+}
+
+// false for an unknown command or a setting out of range
+boolean runRemoteCommand(byte command, const byte *args) {
+  switch (command) {
+    case REMOTE_EFFECT:
+      if (args[0] >= numEffects) return false;
+      currentEffect = args[0];
+      tasks[TASK_CYCLE].period = cycleTime; // in case it was waiting for a bar
+      rescheduleTask(TASK_CYCLE);
+      selectEffect(currentEffect);
+      remoteSettingChanged();
+      break;
+
+    case REMOTE_BRIGHTNESS:
+      currentBrightness = args[0];
+      remoteSettingChanged();
+      break;
+
+    case REMOTE_AUTOCYCLE:
+      autoCycle = args[0] != 0;
+      remoteSettingChanged();
+      break;
+
+    case REMOTE_AUDIO:
+      audioEnabled = args[0] != 0;
+      numEffects = audioEnabled ? numEffectsAudio : numEffectsNoAudio;
+      currentEffect = 0;
+      selectEffect(currentEffect);
+      remoteSettingChanged();
+      break;
+
+    default:
+      return false;
+  }
+  return true;
+}
+
+// Read one packet after its sync bytes and act on it
+void remoteReadPacket() {
+  int command = remoteReadByte();
+  int low = remoteReadByte();
+  int high = remoteReadByte();
+  if (command < 0 || low < 0 || high < 0) {
+    Serial.write(REMOTENAK);
+    return;
+  }
+  uint16_t length = low | (high << 8);
+  byte crc = crc8Byte(crc8Byte(crc8Byte(0, command), low), high);
+
+  byte args[REMOTEMAXARGS];
+  if (command == REMOTE_FRAME) {
+    if (length != NUM_LEDS * 2) {
+      Serial.write(REMOTENAK);
+      return;
+    }
+    if (effectRender != remoteFrameRender) startRemoteFrames();
+    remoteFrameMillis = currentMillis;
+    remoteFrameBad = true; // until the crc passes
+    int frameCrc = remoteReadFrame(crc);
+    if (frameCrc < 0) {
+      Serial.write(REMOTENAK);
+      return;
+    }
+    crc = frameCrc;
+  } else {
+    if (length > REMOTEMAXARGS) {
+      Serial.write(REMOTENAK);
+      return;
+    }
+    for (byte i = 0; i < length; i++) {
+      int data = remoteReadByte();
+      if (data < 0) {
+        Serial.write(REMOTENAK);
+        return;
+      }
+      args[i] = data;
+      crc = crc8Byte(crc, data);
+    }
+  }
+
+  if (remoteReadByte() != crc) {
+    Serial.write(REMOTENAK);
+    return;
+  }
+
+  if (command == REMOTE_FRAME) {
+    remoteFrameBad = false;
+    frameDirty = true;
+    remoteAckPending = true; // once the show task has sent it out
+    return;
+  }
+  Serial.write(length > 0 && runRemoteCommand(command, args) ? REMOTEACK : REMOTENAK);
+}
+
+// Runs at the start of every pass, the frame is acknowledged once a pass
+// showed it (the show task may hold it back, see AUDIOHOLDSSHOW)
+void remotePoll() {
+  if (remoteAckPending) {
+    if (frameDirty) return;
+    Serial.write(REMOTEACK);
+    remoteAckPending = false;
+  }
+  if (effectRender == remoteFrameRender && currentMillis - remoteFrameMillis > REMOTETIMEOUT) {
+    if (remoteFrameBad) fillAll(CRGB::Black); // fade in from black, not from the broken frame
+    remoteFrameBad = false;
+    selectEffect(currentEffect);
+  }
+
+  while (Serial.available()) {
+    if (Serial.read() != REMOTESYNC0) continue;
+    if (remoteReadByte() != REMOTESYNC1) continue;
+    remoteReadPacket();
+    return;
+  }
+}
+
+#define REMOTE_SETUP() Serial.begin(REMOTEBAUD)
+#define REMOTE_LOOP() remotePoll()
+#define REMOTE_STREAMING() (effectRender == remoteFrameRender)
+#define REMOTE_HOLDSSHOW() remoteFrameBad
+
+#else
+
+#define REMOTE_SETUP()
+#define REMOTE_LOOP()
+#define REMOTE_STREAMING() false
+#define REMOTE_HOLDSSHOW() false
+
+#endif
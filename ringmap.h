@@ -0,0 +1,80 @@
+// Compile time ring maps for concentric shape effects
+//
+// A ring map holds, for every pixel along the strip, how many pixels out
+// from the middle of the layout it is, measured in the shape of a heart, a
+// circle or a diamond. drawRings() (effects.h) colors the rings in a single
+// pass over leds[], reading the map in strip order. Holes in the layout are
+// marked RINGHOLE and skipped, which keeps the count of visible pixels in
+// step with the strip.
+//
+// The maps are generated by the compiler for whatever layout XYMAP
+// describes, one byte per pixel in PROGMEM, using the cell lists and strip
+// helpers from XYlayout.h.
+
+#define RINGHOLE 255
+#define RINGMAX 254
+
+enum ringShape {
+  RING_HEART,
+  RING_CIRCLE,
+  RING_DIAMOND,
+};
+
+// floor(sqrt(value)) by halving the range, as a single expression
+constexpr unsigned int ringSqrt(unsigned long value, unsigned int low, unsigned int high) {
+  return high - low <= 1 ? low :
+         (unsigned long)((low + high) / 2) * ((low + high) / 2) <= value ?
+         ringSqrt(value, (low + high) / 2, high) : ringSqrt(value, low, (low + high) / 2);
+}
+
+constexpr unsigned int ringSqrt(unsigned long value) {
+  return ringSqrt(value, 0, 1024);
+}
+
+constexpr long ringSquare(long value) {
+  return value * value;
+}
+
+constexpr long ringAbs(long value) {
+  return value < 0 ? -value : value;
+}
+
+// Distance from the middle in half pixels, dx and dy are in half pixels too
+// so layouts with an even size have their middle between two pixels.
+// The heart is a circle pushed up by the distance to the center line, which
+// gives the dip on top and the point at the bottom; it is narrowed a little
+// and sits a pixel above the middle.
+constexpr unsigned int ringDistance(ringShape shape, long dx, long dy) {
+  return shape == RING_HEART ? ringSqrt(ringSquare(dx) * 4 / 5 + ringSquare(dy + ringAbs(dx) - 2)) :
+         shape == RING_CIRCLE ? ringSqrt(ringSquare(dx) + ringSquare(dy)) :
+         ringAbs(dx) + ringAbs(dy);
+}
+
+constexpr unsigned int ringOfCell(ringShape shape, unsigned int x, unsigned int y) {
+  return ringDistance(shape, 2L * x - (kMatrixWidth - 1), 2L * y - (kMatrixHeight - 1)) / 2;
+}
+
+constexpr byte ringEntry(ringShape shape, unsigned int position) {
+  return xyHole(xyCell(position)) ? RINGHOLE :
+         ringOfCell(shape, xyCell(position) % kMatrixWidth, xyCell(position) / kMatrixWidth) > RINGMAX ? RINGMAX :
+         ringOfCell(shape, xyCell(position) % kMatrixWidth, xyCell(position) / kMatrixWidth);
+}
+
+// Rings needed to reach the middle of the left edge, the VU effects fill
+// the layout from the middle to the sides like drawVU()
+constexpr byte ringLevels(ringShape shape) {
+  return ringOfCell(shape, 0, kMatrixHeight / 2) + 1;
+}
+
+struct ringTableType {
+  byte ring[NUM_LEDS];
+};
+
+template <unsigned int... positions>
+constexpr ringTableType ringMakeTable(ringShape shape, xyCells<positions...>) {
+  return ringTableType{{ ringEntry(shape, positions)... }};
+}
+
+const ringTableType ringHeart PROGMEM = ringMakeTable(RING_HEART, xyMakeCells<NUM_LEDS>::type());
+const ringTableType ringCircle PROGMEM = ringMakeTable(RING_CIRCLE, xyMakeCells<NUM_LEDS>::type());
+const ringTableType ringDiamond PROGMEM = ringMakeTable(RING_DIAMOND, xyMakeCells<NUM_LEDS>::type());
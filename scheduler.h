@@ -0,0 +1,103 @@
+// Deadline based cooperative scheduler for loop()
+//
+// Every job loop() does is a task with a period and a deadline. The task
+// table is in priority order. Each pass of loop() runs the most important
+// task that is due, then scans from the top again, so a due audio update
+// runs before an effect frame that is waiting and never sits behind more
+// than one task. A task runs at most once per pass, so slow passes cannot
+// starve the less important ones. Tasks with a period of 0 are idle tasks
+// and run once at the end of every pass.
+//
+// Deadlines advance by whole periods, so a task keeps its rate when it
+// starts a little late, but one that falls a full period behind restarts
+// from now instead of running back to back to catch up. A task may change
+// its own period while it runs (the effect does, through effectDelay).
+//
+// Lateness, how long after its deadline a task started, is kept per task.
+
+#define MAXTASKS 16 // tasks run this pass are tracked in an unsigned int
+
+struct schedTask {
+  void (*run)();
+  unsigned int period;      // milliseconds between runs, 0 to run when idle
+  unsigned long due;        // micros() deadline of the next run
+  unsigned int runs;        // runs since the last reset, saturates
+  unsigned long maxLate;    // microseconds
+  unsigned long totalLate;  // microseconds
+};
+
+extern schedTask tasks[];
+extern const byte numTasks;
+
+void runTask(schedTask &task, unsigned long now) {
+  if (task.runs < 0xFFFF) task.runs++;
+  if (task.period != 0) {
+    unsigned long late = now - task.due;
+    if (late > task.maxLate) task.maxLate = late;
+    task.totalLate += late;
+  }
+
+  task.run();
+
+  if (task.period != 0) {
+    task.due += task.period * 1000UL;
+    if ((long)(now - task.due) >= 0) task.due = now + task.period * 1000UL;
+  }
+}
+
+// One pass: every due task, most important first, then the idle tasks
+void runTasks() {
+  unsigned int ran = 0;
+
+  byte i = 0;
+  while (i < numTasks) {
+    schedTask &task = tasks[i];
+    unsigned long now = micros();
+    if (task.period == 0 || (ran & (1U << i)) || (long)(now - task.due) < 0) {
+      i++;
+      continue;
+    }
+    ran |= 1U << i;
+    runTask(task, now);
+    i = 0; // something more important may have come due meanwhile
+  }
+
+  for (i = 0; i < numTasks; i++) {
+    if (tasks[i].period == 0) runTask(tasks[i], micros());
+  }
+}
+
+// Start a task's period over from now, e.g. after a manual effect change
+void rescheduleTask(byte slot) {
+  tasks[slot].due = micros() + tasks[slot].period * 1000UL;
+}
+
+// First deadlines are one period after startup
+void startTasks() {
+  for (byte i = 0; i < numTasks; i++) rescheduleTask(i);
+}
+
+void resetTaskStats() {
+  for (byte i = 0; i < numTasks; i++) {
+    tasks[i].runs = 0;
+    tasks[i].maxLate = 0;
+    tasks[i].totalLate = 0;
+  }
+}
+
+// Print per task lateness over Serial, one line per task in priority order
+void dumpTaskStats() {
+  Serial.println(F("task\tperiod\truns\tavglate\tmaxlate"));
+  for (byte i = 0; i < numTasks; i++) {
+    schedTask &task = tasks[i];
+    Serial.print(i);
+    Serial.print('\t');
+    Serial.print(task.period);
+    Serial.print('\t');
+    Serial.print(task.runs);
+    Serial.print('\t');
+    Serial.print(task.runs ? task.totalLate / task.runs : 0);
+    Serial.print('\t');
+    Serial.println(task.maxLate);
+  }
+}
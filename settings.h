@@ -0,0 +1,133 @@
+// Settings journal in EEPROM
+//
+// Every save appends a SETTINGSRECORDSIZE byte record to the next slot of
+// a ring that covers the whole EEPROM, instead of rewriting the same
+// cells. Each cell is written once every SETTINGSSLOTS saves, 128 on the
+// 1KB ATmega328, so its 100,000 write cycles last for millions of saves.
+//
+// Record:
+//
+//   0  2  sequence number, little endian, one more than the previous record
+//   2  1  currentEffect
+//   3  1  SETTINGS_AUTOCYCLE, SETTINGS_AUDIO flags
+//   4  1  currentBrightness
+//   5  1  currentPaletteChoice, see selectPalette()
+//   6  1  SETTINGSTAG, written last
+//   7  1  crc8() of bytes 0-6
+//
+// saveSettings() clears the tag of the slot before writing the rest, so a
+// save cut short by a power glitch leaves an untagged slot and the record
+// before it stays the newest. loadSettings() reads only the tag and
+// sequence number of each slot to find the newest record, then checks its
+// crc; a bad one is skipped for the record before it. Without any record the
+// settings from the older fixed layout (99 at address 0, then effect,
+// auto cycle and brightness) are loaded; the first save overwrites them.
+// If tagged records exist but none of them is good, the next save still
+// follows the newest one, so it stays newest on the next load.
+
+#define SETTINGSRECORDSIZE 8
+#define SETTINGSSLOTS ((E2END + 1) / SETTINGSRECORDSIZE)
+#define SETTINGSTAG 0x5E // never in an erased cell or the old layout
+#define SETTINGSOLDMAGIC 99
+#define SETTINGS_AUTOCYCLE 1
+#define SETTINGS_AUDIO 2
+
+// Global variables
+int settingsSlot = -1;           // slot of the newest record, -1 for none
+uint16_t settingsSequence = 0;   // its sequence number
+byte savedSettings[SETTINGSRECORDSIZE]; // last good record, untagged if there is none
+
+// Record of the current settings
+void packSettings(byte *record, uint16_t sequence) {
+  record[0] = sequence;
+  record[1] = sequence >> 8;
+  record[2] = currentEffect;
+  record[3] = (autoCycle ? SETTINGS_AUTOCYCLE : 0) | (audioEnabled ? SETTINGS_AUDIO : 0);
+  record[4] = currentBrightness;
+  record[5] = currentPaletteChoice;
+  record[6] = SETTINGSTAG;
+  record[7] = crc8(record, SETTINGSRECORDSIZE - 1);
+}
+
+// Copy a slot into record, true if it holds a complete record
+boolean readSettings(int slot, byte *record) {
+  for (byte i = 0; i < SETTINGSRECORDSIZE; i++) record[i] = EEPROM.read(slot * SETTINGSRECORDSIZE + i);
+  return record[6] == SETTINGSTAG && record[7] == crc8(record, SETTINGSRECORDSIZE - 1);
+}
+
+uint16_t settingsSequenceAt(int slot) {
+  int address = slot * SETTINGSRECORDSIZE;
+  return EEPROM.read(address) | (EEPROM.read(address + 1) << 8);
+}
+
+// Find the newest good record and apply it, true if there was one
+boolean loadSettings() {
+  // newest tagged slot, comparing sequence numbers so they may wrap
+  int newest = -1;
+  uint16_t newestSequence = 0;
+  for (int slot = 0; slot < SETTINGSSLOTS; slot++) {
+    if (EEPROM.read(slot * SETTINGSRECORDSIZE + 6) != SETTINGSTAG) continue;
+    uint16_t sequence = settingsSequenceAt(slot);
+    if (newest < 0 || (int16_t)(sequence - newestSequence) > 0) {
+      newest = slot;
+      newestSequence = sequence;
+    }
+  }
+
+  // the next save goes after the newest slot even if no record is good
+  settingsSlot = newest;
+  settingsSequence = newestSequence;
+
+  // walk back over torn records along the run of sequence numbers
+  byte record[SETTINGSRECORDSIZE];
+  for (int tries = 0; newest >= 0 && tries < SETTINGSSLOTS; tries++) {
+    if (readSettings(newest, record)) {
+      memcpy(savedSettings, record, SETTINGSRECORDSIZE);
+      currentEffect = record[2];
+      autoCycle = record[3] & SETTINGS_AUTOCYCLE;
+      audioEnabled = record[3] & SETTINGS_AUDIO;
+      currentBrightness = record[4];
+      currentPaletteChoice = record[5];
+      return true;
+    }
+    newest = newest > 0 ? newest - 1 : SETTINGSSLOTS - 1;
+    if (EEPROM.read(newest * SETTINGSRECORDSIZE + 6) != SETTINGSTAG ||
+        settingsSequenceAt(newest) != --newestSequence) break;
+  }
+
+  if (EEPROM.read(0) == SETTINGSOLDMAGIC) {
+    currentEffect = EEPROM.read(1);
+    autoCycle = EEPROM.read(2);
+    currentBrightness = EEPROM.read(3);
+  }
+  return false;
+}
+
+// Append a record if the settings changed since the last one
+void saveSettings() {
+  byte record[SETTINGSRECORDSIZE];
+  packSettings(record, settingsSequence + 1);
+  if (savedSettings[6] == SETTINGSTAG && memcmp(record + 2, savedSettings + 2, SETTINGSRECORDSIZE - 3) == 0) return;
+
+  int slot = settingsSlot + 1 < SETTINGSSLOTS ? settingsSlot + 1 : 0;
+  // untag the slot first and tag it last, so a torn record is never newest
+  int address = slot * SETTINGSRECORDSIZE;
+  updateEEPROM(address + 6, 0);
+  for (byte i = 0; i < 6; i++) updateEEPROM(address + i, record[i]);
+  updateEEPROM(address + 7, record[7]);
+  updateEEPROM(address + 6, SETTINGSTAG);
+
+  settingsSlot = slot;
+  settingsSequence++;
+  memcpy(savedSettings, record, SETTINGSRECORDSIZE);
+}
+
+// Write settings to EEPROM if necessary
+void checkEEPROM() {
+  if (eepromOutdated) {
+    if (currentMillis - eepromMillis > EEPROMDELAY) {
+      saveSettings();
+      eepromOutdated = false;
+    }
+  }
+}
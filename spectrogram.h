@@ -0,0 +1,53 @@
+// Spectrum history for the scrolling analyzer effects
+//
+// A spectrogram keeps the last SPECTROGRAMDEPTH spectra, all seven bands
+// of spectrumDecay packed into a byte each (halved, so levels up to 510
+// keep their shape). Pushing a spectrum overwrites the oldest one and moves
+// the head, so the effects scroll without shifting any arrays.
+//
+// Memory: 7 bytes per spectrum plus 5 bytes of bookkeeping, enough
+// spectra to cover the longer side of the layout: 110 bytes on the 15x15
+// panel, 117 on the 16x5 shades. It lives in effectState, so it only
+// takes SRAM while an effect that scrolls is running (the union grows to
+// this size) and starts out empty with every new effect.
+
+#define SPECTROGRAMDEPTH (kMatrixWidth > kMatrixHeight ? kMatrixWidth : kMatrixHeight)
+#define SPECTROGRAMMAXBYTES 160 // a bigger layout needs a shallower history, see effectState
+
+struct spectrogram {
+  byte levels[SPECTROGRAMDEPTH][7]; // spectrumDecay / 2 per band
+  byte head;                        // where the next spectrum goes
+  unsigned long pushMicros;         // start of the current push period
+};
+
+static_assert(sizeof(spectrogram) <= SPECTROGRAMMAXBYTES, "spectrogram too big for effectState");
+
+// Store the current spectrum over the oldest one
+void pushSpectrum(spectrogram &history) {
+  byte *levels = history.levels[history.head];
+  for (byte i = 0; i < 7; i++) {
+    unsigned int level = (unsigned int)spectrumDecay[i] >> 1;
+    levels[i] = level > 255 ? 255 : level;
+  }
+  if (++history.head >= SPECTROGRAMDEPTH) history.head = 0;
+}
+
+// Push a spectrum for every period of stepMillis since the last call
+// A stall repeats the current spectrum rather than leaving a gap
+void updateSpectrogram(spectrogram &history, unsigned int stepMillis) {
+  byte steps = elapsedSteps(history.pushMicros, stepMillis * 1000UL);
+  if (steps > SPECTROGRAMDEPTH) steps = SPECTROGRAMDEPTH;
+  for (byte i = 0; i < steps; i++) pushSpectrum(history);
+}
+
+// The packed bands of one spectrum, age 0 is the newest
+const byte *spectrogramRow(const spectrogram &history, byte age) {
+  int slot = (int)history.head - 1 - age;
+  if (slot < 0) slot += SPECTROGRAMDEPTH;
+  return history.levels[slot];
+}
+
+// Level of a band in spectrumDecay units
+unsigned int spectrogramLevel(const spectrogram &history, byte age, byte band) {
+  return spectrogramRow(history, age)[band] << 1;
+}
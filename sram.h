@@ -0,0 +1,50 @@
+// Free SRAM between the heap and the stack
+//
+// setup() paints everything below the stack pointer down to the end of the
+// heap with STACKPAINT. The stack only ever grows down into that gap, so
+// the painted bytes left at the bottom are how close the stack has come to
+// the heap (and to corrupting leds[] and the other globals below it) since
+// the paint. The profiler (profiler.h) prints both numbers and repaints on
+// reset, the bench (benchmark.h) repaints before each effect.
+//
+// Off the device there is no such gap and both numbers are 0.
+
+#define STACKPAINT 0xC5
+
+#ifdef __AVR__
+extern uint8_t __heap_start;
+extern void *__brkval;
+
+uint8_t *heapEnd() {
+  return __brkval ? (uint8_t *)__brkval : &__heap_start;
+}
+
+// Everything below SP is unused, so this is safe at any time
+void paintStack() {
+  uint8_t *top = (uint8_t *)SP;
+  for (uint8_t *p = heapEnd(); p < top; p++) *p = STACKPAINT;
+}
+
+// Bytes the stack has not reached since the last paint
+unsigned int stackUnused() {
+  uint8_t *p = heapEnd();
+  uint8_t *top = (uint8_t *)SP;
+  while (p < top && *p == STACKPAINT) p++;
+  return p - heapEnd();
+}
+
+// Bytes between the heap and the stack right now
+unsigned int sramFree() {
+  return (uint8_t *)SP - heapEnd();
+}
+#else
+void paintStack() {}
+
+unsigned int stackUnused() {
+  return 0;
+}
+
+unsigned int sramFree() {
+  return 0;
+}
+#endif
@@ -0,0 +1,143 @@
+// Scrolling text renderer
+//
+// The text scrolls through a canvas of kMatrixWidth columns, one bit per
+// row, used as a ring: a shift writes the new column over the oldest one
+// and moves the head, so nothing is copied. Each text line streams its
+// message from PROGMEM a glyph column at a time, reading Font[] directly,
+// which makes a shift cost the same few cycles at any point of the text.
+//
+// Glyphs are as wide as their lit columns (space is TEXTSPACEWIDTH) with
+// TEXTSPACING empty columns after each. Layouts tall enough get
+// TEXTLINES lines, each scrolling the next message, centred vertically.
+//
+// drawText() looks up the color of each row once per frame and walks the
+// ring from the head with a compare for the wrap, no modulo per pixel.
+
+#define TEXTGLYPHWIDTH 5  // columns in Font[]
+#define TEXTGLYPHHEIGHT 5
+#define TEXTSPACING 1     // empty columns after each glyph
+#define TEXTSPACEWIDTH 2
+#define TEXTUNKNOWNGLYPH (sizeof(Font) / sizeof(Font[0]) - 1) // the block at the end of Font[]
+#define TEXTLINEPITCH (TEXTGLYPHHEIGHT + 1)
+#define TEXTLINES (kMatrixHeight >= 2 * TEXTLINEPITCH - 1 ? 2 : 1) // a canvas column holds 16 rows
+#define TEXTROWS (TEXTLINES * TEXTLINEPITCH - 1)
+#define TEXTTOP (kMatrixHeight > TEXTROWS ? (kMatrixHeight - TEXTROWS) / 2 : 0)
+#define TEXTMESSAGES (sizeof(stringArray) / sizeof(stringArray[0]))
+
+#define NORMAL 0
+#define RAINBOW 1
+
+struct textLine {
+  const char *message; // start of the message in PROGMEM
+  byte messageChar;    // glyph being streamed
+  const char *glyph;   // its columns in Font[]
+  byte glyphColumn;    // next column of the glyph
+  byte glyphWidth;     // lit columns plus TEXTSPACING
+};
+
+struct scrollTextState {
+  uint16_t canvas[kMatrixWidth]; // one bit per row, bit 0 at the top
+  byte head;                     // oldest column, drawn at the left edge
+  uint16_t shiftTicks;           // frameTicks not yet scrolled
+  uint16_t paletteCycle;         // 8.8 fixed point
+  textLine lines[TEXTLINES];
+};
+
+// Glyph for a character, lowercase is drawn as uppercase
+const char *textGlyph(char character) {
+  byte index = character;
+  if (index >= 32 && index <= 95) {
+    index -= 32; // subtract font array offset
+  } else if (index >= 97 && index <= 122) {
+    index -= 64; // subtract font array offset and convert lowercase to uppercase
+  } else {
+    index = TEXTUNKNOWNGLYPH;
+  }
+  return Font[index];
+}
+
+// Start streaming the glyph of the current character, skipping its empty columns
+void loadTextGlyph(textLine &line) {
+  char character = pgm_read_byte(line.message + line.messageChar);
+  if (character == 0) { // end of the message, start over
+    line.messageChar = 0;
+    character = pgm_read_byte(line.message);
+  }
+  line.glyph = textGlyph(character);
+
+  byte first = 0;
+  byte last = 0;
+  for (byte i = 0; i < TEXTGLYPHWIDTH; i++) {
+    if (pgm_read_byte(line.glyph + i) == 0) continue;
+    if (last == 0) first = i;
+    last = i + 1;
+  }
+  if (last == 0) { // space
+    line.glyphColumn = TEXTGLYPHWIDTH;
+    line.glyphWidth = TEXTGLYPHWIDTH + TEXTSPACEWIDTH;
+  } else {
+    line.glyphColumn = first;
+    line.glyphWidth = last + TEXTSPACING;
+  }
+}
+
+void startText(scrollTextState &state, byte message) {
+  for (byte i = 0; i < TEXTLINES; i++) {
+    textLine &line = state.lines[i];
+    line.message = (const char *)pgm_read_ptr(&stringArray[(message + i) % TEXTMESSAGES]);
+    line.messageChar = 0;
+    loadTextGlyph(line);
+  }
+}
+
+// Next column of a line, empty between glyphs
+byte nextTextColumn(textLine &line) {
+  byte column = 0;
+  if (line.glyphColumn < TEXTGLYPHWIDTH) column = pgm_read_byte(line.glyph + line.glyphColumn);
+  if (++line.glyphColumn >= line.glyphWidth) {
+    line.messageChar++;
+    loadTextGlyph(line);
+  }
+  return column;
+}
+
+// Scroll one column to the left
+void shiftText(scrollTextState &state) {
+  uint16_t column = 0;
+  for (byte i = 0; i < TEXTLINES; i++) {
+    column |= (uint16_t)nextTextColumn(state.lines[i]) << (i * TEXTLINEPITCH);
+  }
+  state.canvas[state.head] = column;
+  if (++state.head >= kMatrixWidth) state.head = 0;
+}
+
+// Scroll a column for every frame that passed
+void scrollTextFrames(scrollTextState &state) {
+  state.shiftTicks += frameTicks;
+  byte shifts = 0;
+  while (state.shiftTicks >= 256) {
+    state.shiftTicks -= 256;
+    if (shifts++ < kMatrixWidth) shiftText(state);
+  }
+}
+
+void drawText(const scrollTextState &state, byte style, CRGB fgColor, CRGB bgColor) {
+  CRGB rowColors[TEXTROWS];
+  for (byte y = 0; y < TEXTROWS; y++) {
+    if (style == RAINBOW) {
+      rowColors[y] = ColorFromPalette(currentPalette, (state.paletteCycle >> 8) + (y % TEXTLINEPITCH) * 16, 255);
+    } else {
+      rowColors[y] = fgColor;
+    }
+  }
+
+  byte slot = state.head;
+  for (byte x = 0; x < kMatrixWidth; x++) {
+    uint16_t column = state.canvas[slot];
+    if (++slot >= kMatrixWidth) slot = 0;
+    for (byte y = 0; y < kMatrixHeight; y++) {
+      byte row = y - TEXTTOP;
+      leds[XY(x, y)] = row < TEXTROWS && (column >> row) & 1 ? rowColors[row] : bgColor;
+    }
+  }
+}
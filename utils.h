@@ -1,14 +1,19 @@
 // Assorted useful functions and variables
 
 // Global variables
-boolean effectInit = false; // indicates if a pattern has been recently switched
 uint16_t effectDelay = 0; // time between automatic effect changes
-unsigned long effectMillis = 0; // store the time of last effect function run
-unsigned long cycleMillis = 0; // store the time of last effect change
+boolean frameDirty = true; // leds[] may have been written since the last show
+uint32_t shownHash = 0; // frameHash() of the frame on the LEDs
+byte shownBrightness = 0; // brightness of the frame on the LEDs, 0 until the first show
+uint32_t frameLoad = 0; // power drawn by the last hashed frame at full brightness, see frameHash()
+unsigned int frameMilliamps = 0; // estimated current of the frame on the LEDs
+unsigned int peakMilliamps = 0;
+unsigned long showsSkipped = 0; // passes where the frame was unchanged
+byte showCount = 0; // FastLED.show() calls, wraps; interrupts are off during each
+uint16_t frameTicks = 256; // time since the previous effect frame, in 1/256ths of effectDelay
+unsigned long frameMicros; // start of the previous effect frame
 unsigned long currentMillis; // store current loop's millis value
-unsigned long hueMillis; // store time of last hue change
 unsigned long eepromMillis; // store time of last setting change
-unsigned long audioMillis; // store time of last audio update
 byte currentEffect = 0; // index to the currently running effect
 boolean autoCycle = true; // flag for automatic effect changes
 boolean eepromOutdated = false; // flag for when EEPROM may need to be updated
@@ -16,6 +21,7 @@ byte currentBrightness = STARTBRIGHTNESS; // 0-255 will be scaled to 0-MAXBRIGHT
 boolean audioEnabled = false; // flag for running audio patterns
 
 CRGBPalette16 currentPalette(RainbowColors_p); // global palette storage
+byte currentPaletteChoice = 5; // list and entry of currentPalette, see selectPalette()
 
 typedef void (*functionList)(); // definition for list of effect function pointers
 extern byte numEffects;
@@ -29,16 +35,74 @@ void hueCycle(byte incr) {
   cycleHue += incr;
 }
 
+// Integer square root of a slowly changing value, for distance effects
+// Moves the previous root up or down until it fits, so a value that changes
+// by a small distance costs a few additions instead of a full square root
+struct distanceTracker {
+  unsigned int root;     // floor(sqrt(value))
+  unsigned long rootSq;  // root * root
+};
+
+void trackDistance(distanceTracker &distance, unsigned long value) {
+  while (distance.rootSq > value) {
+    distance.root--;
+    distance.rootSq -= 2 * distance.root + 1;
+  }
+  while (distance.rootSq + 2 * distance.root + 1 <= value) {
+    distance.rootSq += 2 * distance.root + 1;
+    distance.root++;
+  }
+}
+
+// Frame clock
+// Effects move their counters by frameTicks, which is 256 when a frame
+// runs exactly effectDelay after the previous one. A late frame moves them
+// further, so the speed of an animation does not depend on the frame rate.
+// Gaps over FRAMEMAXMICROS (a blink, a stall) count as that long.
+#define FRAMEMAXMICROS 250000
+
+void frameClockStart() {
+  frameMicros = micros();
+  frameTicks = 256;
+}
+
+void frameClockTick() {
+  unsigned long now = micros();
+  unsigned long elapsed = now - frameMicros;
+  frameMicros = now;
+  if (elapsed > FRAMEMAXMICROS) elapsed = FRAMEMAXMICROS;
+  if (effectDelay == 0) return;
+  frameTicks = elapsed * 32 / (effectDelay * 125UL); // 256 / 1000 = 32 / 125
+}
+
+// Whole steps of stepMicros since mark, mark advances by the steps taken
+// Used for post-processing that runs outside the effect frames
+// At most 255 steps per call, with short steps the rest come on the next calls
+byte elapsedSteps(unsigned long &mark, unsigned long stepMicros) {
+  unsigned long elapsed = micros() - mark;
+  boolean stalled = elapsed > FRAMEMAXMICROS;
+  if (stalled) elapsed = FRAMEMAXMICROS;
+
+  unsigned long steps = elapsed / stepMicros;
+  if (steps > 255) steps = 255;
+  if (stalled) {
+    mark = micros();
+  } else {
+    mark += steps * stepMicros;
+  }
+  return steps;
+}
+
 // Set every LED in the array to a specified color
 void fillAll(CRGB fillColor) {
-  for (byte i = 0; i < NUM_LEDS; i++) {
+  for (ledindex_t i = 0; i < NUM_LEDS; i++) {
     leds[i] = fillColor;
   }
 }
 
 // Fade every LED in the array by a specified amount
 void fadeAll(byte fadeIncr) {
-  for (byte i = 0; i < NUM_LEDS; i++) {
+  for (ledindex_t i = 0; i < NUM_LEDS; i++) {
     leds[i] = leds[i].fadeToBlackBy(fadeIncr);
   }
 }
@@ -61,9 +125,11 @@ void scrollArray(byte scrollDir) {
 }
 
 
-// Pick a random palette from a list
-void selectRandomPalette() {
-  switch (random8(8)) {
+// Load a palette by its place in the lists below, PALETTEAUDIO for the audio list
+// Entry 3 is not used in either list and leaves the palette as it was
+#define PALETTEAUDIO 0x80
+void selectPalette(byte choice) {
+  switch (choice) {
     case 0:
       currentPalette = CloudColors_p;
       break;
@@ -80,51 +146,122 @@ void selectRandomPalette() {
       currentPalette = ForestColors_p;
       break;
 
-    case 5:
-      currentPalette = RainbowColors_p;
-      break;
-
-    case 6:
-      currentPalette = PartyColors_p;
-      break;
-
-    case 7:
-      currentPalette = HeatColors_p;
-      break;
-  }
-
-}
-
-// Pick a random palette from a list
-void selectRandomAudioPalette() {
-  switch (random8(8)) {
-    case 0:
+    case PALETTEAUDIO | 0:
       currentPalette = CRGBPalette16(CRGB::Red, CRGB::Orange, CRGB::Gray);
       break;
 
-    case 1:
+    case PALETTEAUDIO | 1:
       currentPalette = CRGBPalette16(CRGB::Blue, CRGB::Red, CRGB::Red);
       break;
 
-    case 2:
+    case PALETTEAUDIO | 2:
       currentPalette = CRGBPalette16(CRGB::LightGrey, CRGB::MidnightBlue, CRGB::Black);
       break;
 
-    case 4:
+    case PALETTEAUDIO | 4:
       currentPalette = CRGBPalette16(CRGB::DarkGreen, CRGB::PaleGreen);
       break;
 
     case 5:
+    case PALETTEAUDIO | 5:
       currentPalette = RainbowColors_p;
       break;
 
     case 6:
+    case PALETTEAUDIO | 6:
       currentPalette = PartyColors_p;
       break;
 
     case 7:
+    case PALETTEAUDIO | 7:
       currentPalette = HeatColors_p;
       break;
+
+    default:
+      return;
+  }
+  currentPaletteChoice = choice;
+}
+
+// Pick a random palette from a list
+void selectRandomPalette() {
+  selectPalette(random8(8));
+}
+
+// Pick a random palette from a list
+void selectRandomAudioPalette() {
+  selectPalette(PALETTEAUDIO | random8(8));
+}
+
+// Fletcher style checksum of the visible pixels
+// A few cycles per byte, far cheaper than sending an unchanged frame.
+// The same pass weighs each channel by its current draw for the power
+// limiter, so the frame is only read once before it is shown.
+uint32_t frameHash() {
+  uint16_t sum1 = 0;
+  uint16_t sum2 = 0;
+  uint32_t load = 0;
+  for (ledindex_t i = 0; i <= LAST_VISIBLE_LED; i++) {
+    const CRGB &pixel = leds[i];
+    sum1 += pixel.r;
+    sum2 += sum1;
+    sum1 += pixel.g;
+    sum2 += sum1;
+    sum1 += pixel.b;
+    sum2 += sum1;
+    load += REDMILLIAMPS * pixel.r + GREENMILLIAMPS * pixel.g + BLUEMILLIAMPS * pixel.b;
+  }
+  frameLoad = load;
+  return ((uint32_t)sum2 << 16) | sum1;
+}
+
+// Highest brightness up to the one selected with the button that keeps
+// the last hashed frame within MAXMILLIAMPS
+// At brightness b a channel at value v draws about CHANNELMILLIAMPS * v/255 * b/256
+byte limitBrightness() {
+  byte brightness = scale8(currentBrightness, MAXBRIGHTNESS);
+  const uint32_t idle = (uint32_t)IDLEMILLIAMPS * (LAST_VISIBLE_LED + 1);
+  if (MAXMILLIAMPS == 0 || frameLoad == 0) return brightness;
+  if (idle >= MAXMILLIAMPS) return 0;
+
+  uint32_t limit = (MAXMILLIAMPS - idle) * 65280UL / frameLoad; // 255 * 256
+  if (limit < brightness) brightness = limit;
+  return brightness;
+}
+
+// Send the frame at the limited brightness and remember what the strip is showing
+void showFrame(uint32_t hash, byte brightness) {
+  FastLED.setBrightness(brightness);
+  FastLED.show();
+  showCount++;
+  shownHash = hash;
+  shownBrightness = brightness;
+  frameMilliamps = frameLoad * brightness / 65280 + IDLEMILLIAMPS * (LAST_VISIBLE_LED + 1);
+  if (frameMilliamps > peakMilliamps) peakMilliamps = frameMilliamps;
+}
+
+void showFrame(uint32_t hash) {
+  showFrame(hash, limitBrightness());
+}
+
+void showFrame() {
+  showFrame(frameHash());
+}
+
+// Send the frame only if leds[] or the brightness changed since the last
+// show. leds[] is only hashed when something wrote to it (frameDirty).
+void showIfChanged() {
+  uint32_t hash = shownHash;
+  if (frameDirty) {
+    frameDirty = false;
+    hash = frameHash();
+  }
+
+  byte brightness = limitBrightness();
+  if (hash != shownHash || brightness != shownBrightness) {
+    showFrame(hash, brightness);
+  } else {
+    showsSkipped++;
   }
 }
 
@@ -132,56 +269,33 @@ void selectRandomAudioPalette() {
 void confirmBlink(CRGB blinkColor, byte count) {
   for (byte i = 0; i < count; i++) {
     fillAll(blinkColor);
-    FastLED.show();
+    showFrame();
     delay(200);
     fillAll(CRGB::Black);
-    FastLED.show();
+    showFrame();
     delay(200);
   }
 }
 
-// Determine flash address of text string
-unsigned int currentStringAddress = 0;
-void selectFlashString(byte string) {
-  currentStringAddress = pgm_read_word(&stringArray[string]);
-}
-
-// Fetch font character bitmap from flash
-byte charBuffer[5] = {0};
-void loadCharBuffer(byte character) {
-  byte mappedCharacter = character;
-  if (mappedCharacter >= 32 && mappedCharacter <= 95) {
-    mappedCharacter -= 32; // subtract font array offset
-  } else if (mappedCharacter >= 97 && mappedCharacter <= 122) {
-    mappedCharacter -= 64; // subtract font array offset and convert lowercase to uppercase
-  } else {
-    mappedCharacter = 96; // unknown character block
-  }
-
-  for (byte i = 0; i < 5; i++) {
-    charBuffer[i] = pgm_read_byte(Font[mappedCharacter] + i);
-  }
+// CRC-8, polynomial 0x07, for records sent over Serial or kept in EEPROM
+// Four bits at a time from a 16 entry table, fast enough to keep up with
+// bytes arriving at 1Mbaud
+const byte crc8Nibbles[16] PROGMEM = {
+  0x00, 0x07, 0x0E, 0x09, 0x1C, 0x1B, 0x12, 0x15, 0x38, 0x3F, 0x36, 0x31, 0x24, 0x23, 0x2A, 0x2D
+};
+
+byte crc8Byte(byte crc, byte data) {
+  crc ^= data;
+  crc = (crc << 4) ^ pgm_read_byte(&crc8Nibbles[crc >> 4]);
+  return (crc << 4) ^ pgm_read_byte(&crc8Nibbles[crc >> 4]);
 }
 
-// Fetch a character value from a text string in flash
-char loadStringChar(byte string, byte character) {
-  return (char) pgm_read_byte(currentStringAddress + character);
+byte crc8(const byte *data, byte length, byte crc = 0) {
+  for (byte i = 0; i < length; i++) crc = crc8Byte(crc, data[i]);
+  return crc;
 }
 
 // write EEPROM value if it's different from stored value
-void updateEEPROM(byte location, byte value) {
+void updateEEPROM(int location, byte value) {
   if (EEPROM.read(location) != value) EEPROM.write(location, value);
 }
-
-// Write settings to EEPROM if necessary
-void checkEEPROM() {
-  if (eepromOutdated) {
-    if (currentMillis - eepromMillis > EEPROMDELAY) {
-      updateEEPROM(0, 99);
-      updateEEPROM(1, currentEffect);
-      updateEEPROM(2, autoCycle);
-      updateEEPROM(3, currentBrightness);
-      eepromOutdated = false;
-    }
-  }
-}